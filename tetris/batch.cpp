@@ -0,0 +1,206 @@
+#include "batch.h"
+#include <cstddef>
+
+using namespace engine;
+
+// ================================================== class Batch
+const int Batch::MAX_BATCH_WIDTH;
+
+// Shape rows are shifted into a 32 bit word biased by PIECE_SIZE columns, so x down to -PIECE_SIZE
+// needs no branch: bits below the bias or above the width are outside the board.
+static const int BIAS = PIECE_SIZE;
+
+bool Batch::init(int size, int height, int width) {
+    if (size < 1 || height < 1 || height > MAX_HEIGHT || width < PIECE_SIZE || width > MAX_BATCH_WIDTH) {
+        return false;
+    }
+    num = size;
+    h = height;
+    w = width;
+    full = (brow_t) ((1u << width) - 1);
+    for (int k = 0; k < KIND_NUM; ++k) {
+        rotNum[k] = (int8_t) rotationNum(k);
+        for (int r = 0; r < rotNum[k]; ++r) {
+            shapes[k * 4 + r] = shapeOf(k, r);
+        }
+    }
+
+    rowData.assign((size_t) height * size, 0);
+    kind.assign(size, 0);
+    rot.assign(size, 0);
+    posY.assign(size, 0);
+    posX.assign(size, 0);
+    nKind.assign(size, 0);
+    nRot.assign(size, 0);
+    scoreData.assign(size, 0);
+    lineData.assign(size, 0);
+    tick.assign(size, 0);
+    rng.assign(size, tetris::Random());
+    doneData.assign(size, 0);
+    candY.assign(size, 0);
+    candX.assign(size, 0);
+    candRot.assign(size, 0);
+    fit.assign(size, 0);
+    act.assign(size, 0);
+    falling.assign(size, 0);
+    pending.reserve(size);
+
+    resetAll(0);
+    return true;
+}
+
+void Batch::reset(int g, uint64_t seed) {
+    for (int y = 0; y < h; ++y) {
+        rowData[(size_t) y * num + g] = 0;
+    }
+    rng[g].reseed(seed);
+    draw(g, kind[g], rot[g]);
+    draw(g, nKind[g], nRot[g]);
+    posY[g] = (int8_t) START_Y;
+    posX[g] = (int8_t) ((w - PIECE_SIZE) / 2);
+    scoreData[g] = 0;
+    lineData[g] = 0;
+    tick[g] = 0;
+    doneData[g] = 0;
+}
+
+void Batch::resetAll(uint64_t seed) {
+    for (int g = 0; g < num; ++g) {
+        reset(g, seed + g);
+    }
+}
+
+void Batch::step(const uint8_t *actions, int32_t *rewards, uint8_t *dones) {
+    const int n = num;
+
+    // keys: left, right and rotate give one candidate each, none and down keep the current position
+    for (int g = 0; g < n; ++g) {
+        uint8_t a = doneData[g] ? (uint8_t) ACT_NONE : actions[g];
+        act[g] = a;
+        candY[g] = posY[g];
+        candX[g] = (int8_t) (posX[g] + (a == ACT_RIGHT) - (a == ACT_LEFT));
+        int nr = rot[g] + 1;
+        candRot[g] = a == ACT_ROTATE ? (int8_t) (nr == rotNum[kind[g]] ? 0 : nr) : rot[g];
+        falling[g] = !doneData[g] && !(tick[g] % TICK_PER_FALL);
+        tick[g] += !doneData[g];
+        if (rewards) rewards[g] = 0;
+    }
+    fitAll(candY.data(), candX.data(), candRot.data(), kind.data(), fit.data());
+    for (int g = 0; g < n; ++g) {
+        bool ok = fit[g] && !doneData[g];
+        posX[g] = ok ? candX[g] : posX[g];
+        rot[g] = ok ? candRot[g] : rot[g];
+    }
+
+    // down tries several offsets, only for the few games that pressed it
+    pending.clear();
+    for (int g = 0; g < n; ++g) {
+        if (act[g] == ACT_DOWN) pending.push_back(g);
+    }
+    for (int g: pending) {
+        for (int offset = DOWN_STEP; offset; --offset) {
+            if (fitOne(g, posY[g] + offset, posX[g], rot[g], false)) {
+                posY[g] = (int8_t) (posY[g] + offset);
+                break;
+            }
+        }
+    }
+
+    // time to fall
+    for (int g = 0; g < n; ++g) {
+        candY[g] = (int8_t) (posY[g] + 1);
+    }
+    fitAll(candY.data(), posX.data(), rot.data(), kind.data(), fit.data());
+    pending.clear();
+    for (int g = 0; g < n; ++g) {
+        bool down = falling[g] && fit[g];
+        posY[g] = down ? candY[g] : posY[g];
+        if (falling[g] && !fit[g]) pending.push_back(g);
+    }
+    for (int g: pending) {
+        int32_t reward = 0;
+        land(g, reward);
+        if (rewards) rewards[g] = reward;
+    }
+
+    if (dones) {
+        for (int g = 0; g < n; ++g) dones[g] = doneData[g];
+    }
+}
+
+void Batch::fitAll(const int8_t *y, const int8_t *x, const int8_t *r, const int8_t *k, uint8_t *out) const {
+    const int n = num;
+    const brow_t *rows = rowData.data();
+    const uint32_t outside = ~((uint32_t) full << BIAS);
+    for (int g = 0; g < n; ++g) {
+        uint32_t shape = shapes[k[g] * 4 + r[g]];
+        int shift = x[g] + BIAS;
+        uint32_t bad = 0;
+        for (int i = 0; i < PIECE_SIZE; ++i) {
+            uint32_t cells = ((shape >> (i * PIECE_SIZE)) & 0xF) << shift;
+            int cy = y[g] + i;
+            int clamped = cy < 0 ? 0 : (cy >= h ? h - 1 : cy);
+            uint32_t occ = (uint32_t) rows[clamped * n + g] << BIAS;
+            occ = cy < 0 ? 0 : occ;
+            occ = cy >= h ? ~0u : occ;
+            bad |= cells & (occ | outside);
+        }
+        out[g] = bad == 0;
+    }
+}
+
+bool Batch::fitOne(int g, int y, int x, int r, bool includeTop) const {
+    uint32_t shape = shapes[kind[g] * 4 + r];
+    uint32_t outside = ~((uint32_t) full << BIAS);
+    for (int i = 0; i < PIECE_SIZE; ++i) {
+        uint32_t cells = ((shape >> (i * PIECE_SIZE)) & 0xF) << (x + BIAS);
+        if (!cells) continue;
+        int cy = y + i;
+        if (cells & outside || cy >= h || (includeTop && cy < 0)) return false;
+        if (cy >= 0 && (((uint32_t) rowData[(size_t) cy * num + g] << BIAS) & cells)) return false;
+    }
+    return true;
+}
+
+void Batch::draw(int g, int8_t &k, int8_t &r) {
+    k = (int8_t) (rng[g].randint(RAND_NUM_MIN, RAND_NUM_MAX) % KIND_NUM);
+    r = (int8_t) (rng[g].randint(RAND_NUM_MIN, RAND_NUM_MAX) % rotNum[k]);
+}
+
+void Batch::land(int g, int32_t &reward) {
+    if (!fitOne(g, posY[g], posX[g], rot[g], true)) { // Game Over
+        doneData[g] = 1;
+        return;
+    }
+
+    const size_t n = num;
+    uint32_t shape = shapes[kind[g] * 4 + rot[g]];
+    int lines[PIECE_SIZE];
+    int completeNum = 0;
+    for (int i = PIECE_SIZE - 1; i >= 0; --i) {
+        uint32_t cells = ((shape >> (i * PIECE_SIZE)) & 0xF) << (posX[g] + BIAS) >> BIAS;
+        if (!cells) continue;
+        brow_t &row = rowData[(posY[g] + i) * n + g];
+        row |= (brow_t) cells;
+        if (row == full) lines[completeNum++] = posY[g] + i;
+    }
+
+    if (completeNum) {
+        // the lowest complete row is found first, compact upwards from it
+        int dst = lines[0];
+        for (int src = dst; src >= 0; --src) {
+            if (rowData[src * n + g] != full) rowData[dst-- * n + g] = rowData[src * n + g];
+        }
+        while (dst >= 0) rowData[dst-- * n + g] = 0;
+    }
+
+    reward = (int32_t) (completeNum * completeNum * SCORE_BASE);
+    scoreData[g] += reward;
+    lineData[g] += completeNum;
+
+    kind[g] = nKind[g];
+    rot[g] = nRot[g];
+    posY[g] = (int8_t) START_Y;
+    posX[g] = (int8_t) ((w - PIECE_SIZE) / 2);
+    draw(g, nKind[g], nRot[g]);
+}
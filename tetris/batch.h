@@ -0,0 +1,68 @@
+#ifndef TETRIS_BATCH_H
+#define TETRIS_BATCH_H
+
+#include "engine.h"
+#include <vector>
+
+namespace engine {
+    // ================================================== class Batch
+    // Many games of the same size stepped together, same rules as Game.
+    // State is kept as structure of arrays so every phase of a tick is one loop over the batch.
+    class Batch {
+    public:
+        typedef uint16_t brow_t; // narrow rows, so more games fit in a vector register
+        const static int MAX_BATCH_WIDTH = 16;
+
+        Batch() = default;
+
+        bool init(int size, int height = DEFAULT_HEIGHT, int width = DEFAULT_WIDTH);
+        void reset(int g, uint64_t seed);
+        void resetAll(uint64_t seed); // game g gets seed + g
+        // one tick for every game, rewards and dones may be nullptr. A finished game stays done until reset.
+        void step(const uint8_t *actions, int32_t *rewards = nullptr, uint8_t *dones = nullptr);
+
+        int size() const { return num; }
+        int height() const { return h; }
+        int width() const { return w; }
+        // row y of game g is rows()[y * size() + g]
+        const brow_t *rows() const { return rowData.data(); }
+        const int8_t *curKind() const { return kind.data(); }
+        const int8_t *curRot() const { return rot.data(); }
+        const int8_t *curY() const { return posY.data(); }
+        const int8_t *curX() const { return posX.data(); }
+        const int8_t *nxtKind() const { return nKind.data(); }
+        const int8_t *nxtRot() const { return nRot.data(); }
+        const uint32_t *score() const { return scoreData.data(); }
+        const uint32_t *lines() const { return lineData.data(); }
+        const uint8_t *done() const { return doneData.data(); }
+
+    private:
+        void fitAll(const int8_t *y, const int8_t *x, const int8_t *r, const int8_t *k, uint8_t *out) const;
+        bool fitOne(int g, int y, int x, int r, bool includeTop) const;
+        void draw(int g, int8_t &k, int8_t &r);
+        void land(int g, int32_t &reward);
+
+    private:
+        int num = 0;
+        int h = 0;
+        int w = 0;
+        brow_t full = 0;
+        uint16_t shapes[KIND_NUM * 4] = {};
+        int8_t rotNum[KIND_NUM] = {};
+
+        std::vector<brow_t> rowData;
+        std::vector<int8_t> kind, rot, posY, posX;
+        std::vector<int8_t> nKind, nRot;
+        std::vector<uint32_t> scoreData, lineData;
+        std::vector<uint64_t> tick;
+        std::vector<tetris::Random> rng;
+        std::vector<uint8_t> doneData;
+
+        // scratch for candidate positions
+        std::vector<int8_t> candY, candX, candRot;
+        std::vector<uint8_t> fit, act, falling;
+        std::vector<int> pending;
+    };
+}
+
+#endif //TETRIS_BATCH_H
@@ -0,0 +1,78 @@
+#include "book.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace engine;
+
+// ================================================== local functions
+static const char MAGIC[8] = {'T', 'E', 'T', 'R', 'I', 'S', 'O', 'B'};
+
+// ================================================== class OpeningBook
+const uint32_t BookHeader::VERSION;
+
+bool OpeningBook::open(const char *path) {
+    close();
+    if (!file.open(path)) return false;
+
+    auto *h = (const BookHeader *) file.data();
+    if (file.size() < sizeof(BookHeader) || memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        h->version != BookHeader::VERSION || h->headerSize != sizeof(BookHeader) ||
+        file.size() != sizeof(BookHeader) + (size_t) h->count * sizeof(BookEntry)) {
+        file.close();
+        return false;
+    }
+    header = h;
+    entries = (const BookEntry *) ((const char *) file.data() + sizeof(BookHeader));
+    return true;
+}
+
+void OpeningBook::close() {
+    file.close();
+    header = nullptr;
+    entries = nullptr;
+}
+
+bool OpeningBook::isOpen() const {
+    return header != nullptr;
+}
+
+int OpeningBook::height() const {
+    return header ? header->height : 0;
+}
+
+int OpeningBook::width() const {
+    return header ? header->width : 0;
+}
+
+bool OpeningBook::lookup(const Board &b, const Piece &cur, int nxt, Placement &out) const {
+    if (!header || b.height != header->height || b.width != header->width) return false;
+
+    BookEntry key{};
+    key.boardHash = b.hash();
+    key.cur = (uint8_t) cur.kind;
+    key.nxt = (uint8_t) nxt;
+    const BookEntry *end = entries + header->count;
+    const BookEntry *it = std::lower_bound(entries, end, key);
+    if (it == end || it->boardHash != key.boardHash || it->cur != key.cur || it->nxt != key.nxt) return false;
+
+    Piece land[MAX_LANDINGS];
+    int n = landings(b, cur, land);
+    if (std::none_of(land, land + n, [it](const Piece &p) { return p.rot == it->rot && p.x == it->x; })) return false;
+
+    out.rot = it->rot;
+    out.x = it->x;
+    return true;
+}
+
+bool OpeningBook::write(const char *path, int height, int width, std::vector<BookEntry> &entries) {
+    std::sort(entries.begin(), entries.end());
+
+    BookHeader h{};
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = BookHeader::VERSION;
+    h.headerSize = sizeof(BookHeader);
+    h.height = height;
+    h.width = width;
+    h.count = (uint32_t) entries.size();
+    return tetris::MappedFile::writeAtomic(path, &h, sizeof(h), entries.data(), entries.size() * sizeof(BookEntry));
+}
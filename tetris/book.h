@@ -0,0 +1,60 @@
+#ifndef TETRIS_BOOK_H
+#define TETRIS_BOOK_H
+
+#include "bot.h"
+#include "mapped.h"
+#include <vector>
+
+namespace engine {
+    // ================================================== struct BookHeader
+    // Fixed binary layout: header, then count entries sorted by (boardHash, cur, nxt). Used in place.
+    struct BookHeader {
+        const static uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        int32_t height; // board size in cells
+        int32_t width;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    struct BookEntry {
+        uint64_t boardHash; // Board::hash()
+        uint8_t cur; // piece kinds
+        uint8_t nxt;
+        int8_t rot; // where to put cur
+        int8_t x;
+        uint32_t reserved;
+
+        bool operator<(const BookEntry &o) const {
+            return boardHash != o.boardHash ? boardHash < o.boardHash : (cur != o.cur ? cur < o.cur : nxt < o.nxt);
+        }
+    };
+
+    // ================================================== class OpeningBook
+    class OpeningBook {
+    public:
+        OpeningBook() = default;
+
+        bool open(const char *path);
+        void close();
+        bool isOpen() const;
+        int height() const;
+        int width() const;
+        // binary search, no allocation. The hash only narrows the search, an entry is taken only if cur can still
+        // get there from where it is, which also covers spawn rotations the book was not built from
+        bool lookup(const Board &b, const Piece &cur, int nxt, Placement &out) const;
+
+        // sorts entries and writes them
+        static bool write(const char *path, int height, int width, std::vector<BookEntry> &entries);
+
+    private:
+        tetris::MappedFile file;
+        const BookHeader *header = nullptr;
+        const BookEntry *entries = nullptr;
+    };
+}
+
+#endif //TETRIS_BOOK_H
@@ -0,0 +1,124 @@
+// Opening book generator. For every current / next piece pair it searches the best placement from the empty board,
+// then again from every board the book itself leads to, for the given number of pieces.
+// Each search is exhaustive over the two known pieces plus an expectation over `lookahead` unknown ones.
+// The defaults are the well of the terminal game. Pieces spawn there in a random rotation, the book is built from
+// rotation 0 and OpeningBook::lookup only plays an entry the actual piece can reach.
+//
+// usage: tetris_book <out file> [pieces] [width] [height] [lookahead]
+
+#include "book.h"
+#include "bot.h"
+#include "taskpool.h"
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace engine;
+
+namespace {
+    const double DEAD = -1e9;
+
+    struct Node {
+        Board board;
+        int cur;
+        int nxt;
+    };
+
+    // best value of placing the known pieces in order, then the average over unknown kinds
+    double search(const Board &b, const int *known, int knownNum, int ahead, int lines, Placement *best) {
+        if (!knownNum) {
+            if (!ahead) return evaluate(b, lines);
+            double sum = 0;
+            for (int k = 0; k < KIND_NUM; ++k) {
+                sum += search(b, &k, 1, ahead - 1, lines, nullptr);
+            }
+            return sum / KIND_NUM;
+        }
+
+        Piece spawn{(int8_t) known[0], 0, (int8_t) START_Y, (int8_t) ((b.width - PIECE_SIZE) / 2)};
+        Piece land[MAX_LANDINGS];
+        int n = landings(b, spawn, land);
+        const Kernels &k = kernelsFor(b.height, b.width);
+        double value = DEAD;
+        for (int i = 0; i < n; ++i) {
+            Board next = b;
+            k.place(next, land[i]);
+            int cleared = k.clearLines(next, land[i], nullptr);
+            double v = search(next, known + 1, knownNum - 1, ahead, lines + cleared, nullptr);
+            if (v > value) {
+                value = v;
+                if (best) *best = Placement{land[i].rot, land[i].x};
+            }
+        }
+        return value;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <out file> [pieces = 3] [width = %d] [height = %d] [lookahead = 1]\n",
+                argv[0], DEFAULT_WIDTH, DEFAULT_HEIGHT);
+        return 2;
+    }
+    int pieces = argc > 2 ? atoi(argv[2]) : 3;
+    int width = argc > 3 ? atoi(argv[3]) : DEFAULT_WIDTH;
+    int height = argc > 4 ? atoi(argv[4]) : DEFAULT_HEIGHT;
+    int ahead = argc > 5 ? atoi(argv[5]) : 1;
+    if (pieces < 1 || width < PIECE_SIZE || width > MAX_WIDTH || height < PIECE_SIZE || height > MAX_HEIGHT || ahead < 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return 2;
+    }
+
+    Board empty{};
+    empty.reset(height, width);
+    std::vector<Node> level;
+    for (int cur = 0; cur < KIND_NUM; ++cur) {
+        for (int nxt = 0; nxt < KIND_NUM; ++nxt) {
+            level.push_back(Node{empty, cur, nxt});
+        }
+    }
+
+    tetris::TaskPool pool;
+    std::vector<BookEntry> entries;
+    std::set<std::tuple<uint64_t, int, int>> seen;
+    for (int depth = 0; depth < pieces && !level.empty(); ++depth) {
+        std::vector<Placement> best(level.size());
+        std::vector<double> value(level.size());
+        for (size_t i = 0; i < level.size(); ++i) {
+            pool.submit([&, i] {
+                int known[2] = {level[i].cur, level[i].nxt};
+                value[i] = search(level[i].board, known, 2, ahead, 0, &best[i]);
+            });
+        }
+        pool.wait();
+
+        std::vector<Node> next;
+        for (size_t i = 0; i < level.size(); ++i) {
+            if (value[i] <= DEAD) continue;
+            const Node &node = level[i];
+            entries.push_back(BookEntry{node.board.hash(), (uint8_t) node.cur, (uint8_t) node.nxt,
+                                        best[i].rot, best[i].x, 0});
+            if (depth + 1 == pieces) continue;
+
+            Piece p{(int8_t) node.cur, best[i].rot, (int8_t) START_Y, best[i].x};
+            Board b = node.board;
+            while (++p.y, b.fits(p)) {}
+            --p.y;
+            b.place(p);
+            b.clearLines(p);
+            for (int k = 0; k < KIND_NUM; ++k) {
+                if (seen.emplace(b.hash(), node.nxt, k).second) next.push_back(Node{b, node.nxt, k});
+            }
+        }
+        fprintf(stderr, "piece %d: %zu positions, %zu entries\n", depth + 1, level.size(), entries.size());
+        level.swap(next);
+    }
+
+    if (!OpeningBook::write(argv[1], height, width, entries)) {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "bot.h"
+#include "eval.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace engine;
+
+// ================================================== local functions
+static Piece drop(const Kernels &k, const Board &b, Piece p) {
+    Piece down = p;
+    while (++down.y, k.fits(b, down, false)) p = down;
+    return p;
+}
+
+// ================================================== functions
+double engine::evaluate(const Board &b, int lines) {
+    Features f;
+    features(b, f);
+    return -0.510066 * f.aggregateHeight + 0.760666 * lines - 0.35663 * f.holes - 0.184483 * f.bumpiness;
+}
+
+int engine::landings(const Board &b, const Piece &p, Piece *out) {
+    const Kernels &k = kernelsFor(b.height, b.width);
+    int n = 0;
+    Piece r = p;
+    for (int turn = 0; turn < rotationNum(p.kind); ++turn) {
+        if (turn) {
+            r.rot = (int8_t) ((r.rot + 1) % rotationNum(p.kind));
+            if (!k.fits(b, r, false)) break;
+        }
+        for (int dir = -1; dir <= 1; dir += 2) {
+            Piece m = r;
+            if (dir > 0) ++m.x;
+            for (; k.fits(b, m, false); m.x = (int8_t) (m.x + dir)) {
+                Piece landed = drop(k, b, m);
+                if (k.fits(b, landed, true)) out[n++] = landed; // resting above the top is game over
+            }
+        }
+    }
+    return n;
+}
+
+// ================================================== class Bot
+Bot::Bot(int threads) : pool(threads) {}
+
+bool Bot::plan(const Board &board, const Piece &cur, const Piece &nxt, clock::time_point deadline, Placement &out) {
+    Piece first[MAX_LANDINGS];
+    int n = landings(board, cur, first);
+    if (!n) return false;
+
+    const Kernels &k = kernelsFor(board.height, board.width);
+    std::vector<double> score(n, -std::numeric_limits<double>::infinity());
+    for (int i = 0; i < n; ++i) {
+        pool.submit([&, i] {
+            Board b1 = board;
+            k.place(b1, first[i]);
+            int lines1 = k.clearLines(b1, first[i], nullptr);
+            score[i] = evaluate(b1, lines1); // kept if there is no time to look ahead
+
+            Piece second[MAX_LANDINGS];
+            int m = landings(b1, nxt, second);
+            double best = -std::numeric_limits<double>::infinity();
+            for (int j = 0; j < m && clock::now() < deadline; ++j) {
+                Board b2 = b1;
+                k.place(b2, second[j]);
+                int lines2 = k.clearLines(b2, second[j], nullptr);
+                best = std::max(best, evaluate(b2, lines1 + lines2));
+            }
+            if (!m) {
+                score[i] -= 1000; // the next piece will not fit
+            } else if (best > -std::numeric_limits<double>::infinity()) {
+                score[i] = best;
+            }
+        });
+    }
+    pool.wait();
+
+    int best = 0;
+    for (int i = 1; i < n; ++i) {
+        if (score[i] > score[best]) best = i;
+    }
+    out.rot = first[best].rot;
+    out.x = first[best].x;
+    return true;
+}
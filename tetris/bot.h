@@ -0,0 +1,39 @@
+#ifndef TETRIS_BOT_H
+#define TETRIS_BOT_H
+
+#include "engine.h"
+#include "taskpool.h"
+#include <chrono>
+
+namespace engine {
+    // ================================================== variables
+    const int MAX_LANDINGS = 4 * (MAX_WIDTH + PIECE_SIZE);
+
+    struct Placement {
+        int8_t rot;
+        int8_t x;
+    };
+
+    // ================================================== functions
+    // every resting place of p reached by rotating in place, shifting sideways and dropping, return the count
+    int landings(const Board &b, const Piece &p, Piece *out);
+    // higher is better: few high columns, holes and steps, many cleared lines
+    double evaluate(const Board &b, int lines);
+
+    // ================================================== class Bot
+    class Bot {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        explicit Bot(int threads = 0);
+
+        // best placement of cur looking one piece ahead at nxt (at its spawn position).
+        // Candidates are searched in parallel, past the deadline the best found so far is kept.
+        bool plan(const Board &board, const Piece &cur, const Piece &nxt, clock::time_point deadline, Placement &out);
+
+    private:
+        tetris::TaskPool pool;
+    };
+}
+
+#endif //TETRIS_BOT_H
@@ -0,0 +1,53 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace tetris;
+
+// ================================================== local functions
+static const char MAGIC[8] = {'T', 'E', 'T', 'R', 'I', 'S', 'C', 'P'};
+
+// ================================================== class Checkpoint
+const uint32_t CheckpointHeader::VERSION;
+const int CheckpointHeader::MAX_RAND_QUEUE;
+
+bool Checkpoint::open(const char *path) {
+    if (!file.open(path)) return false;
+
+    const CheckpointHeader *h = header();
+    if (file.size() < sizeof(CheckpointHeader) || memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        h->version != CheckpointHeader::VERSION || h->headerSize != sizeof(CheckpointHeader) ||
+        h->height <= 0 || h->width <= 0 || h->randQueueLen > CheckpointHeader::MAX_RAND_QUEUE ||
+        file.size() != sizeof(CheckpointHeader) + (size_t) h->height * h->width) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+void Checkpoint::close() {
+    file.close();
+}
+
+const CheckpointHeader *Checkpoint::header() const {
+    return (const CheckpointHeader *) file.data();
+}
+
+const signed char *Checkpoint::cells() const {
+    return (const signed char *) file.data() + sizeof(CheckpointHeader);
+}
+
+bool Checkpoint::write(const char *path, const CheckpointHeader &header, const signed char *cells) {
+    return MappedFile::writeAtomic(path, &header, sizeof(header), cells, (size_t) header.height * header.width);
+}
+
+void Checkpoint::remove(const char *path) {
+    ::remove(path);
+}
+
+void Checkpoint::initHeader(CheckpointHeader &header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = CheckpointHeader::VERSION;
+    header.headerSize = sizeof(CheckpointHeader);
+}
@@ -0,0 +1,57 @@
+#ifndef TETRIS_CHECKPOINT_H
+#define TETRIS_CHECKPOINT_H
+
+#include "mapped.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace tetris {
+    // ================================================== struct CheckpointHeader
+    // Fixed binary layout, the file is mapped and used in place without parsing.
+    // The header is followed by height * width signed bytes: the game field colors, row-major.
+    struct CheckpointHeader {
+        // 2: the field is a standard well and pieces start on an even column, positions of version 1 do not carry over
+        const static uint32_t VERSION = 2;
+        const static int MAX_RAND_QUEUE = 16;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        int32_t height; // inner size of the game field, in characters
+        int32_t width;
+        uint64_t tick;
+        uint64_t rngState;
+        uint32_t score;
+        int32_t curKind;
+        int32_t curDir;
+        int32_t curY;
+        int32_t curX;
+        int32_t nxtKind;
+        int32_t nxtDir;
+        uint32_t randQueueLen;
+        int32_t randQueue[MAX_RAND_QUEUE];
+    };
+
+    // ================================================== class Checkpoint
+    class Checkpoint {
+    public:
+        Checkpoint() = default;
+
+        // map the file read-only, return false if it is missing or malformed
+        bool open(const char *path);
+        void close();
+
+        const CheckpointHeader *header() const;
+        const signed char *cells() const;
+
+        // write to a temporary file then rename, so a crash never leaves a torn checkpoint
+        static bool write(const char *path, const CheckpointHeader &header, const signed char *cells);
+        static void remove(const char *path);
+        static void initHeader(CheckpointHeader &header);
+
+    private:
+        MappedFile file;
+    };
+}
+
+#endif //TETRIS_CHECKPOINT_H
@@ -0,0 +1,210 @@
+#include "dataset.h"
+#include <cstring>
+#include <utility>
+
+using namespace tetris;
+
+// ================================================== local functions
+static const char MAGIC[8] = {'T', 'E', 'T', 'R', 'I', 'S', 'D', 'S'};
+static const char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+static const size_t ALIGN = 8;
+
+// write bytes and pad them to ALIGN, offset is advanced by both
+static bool writePadded(FILE *f, const void *data, size_t bytes, uint64_t &offset) {
+    static const char zeros[ALIGN] = {};
+    size_t pad = (ALIGN - bytes % ALIGN) % ALIGN;
+    if (bytes && fwrite(data, 1, bytes, f) != bytes) return false;
+    if (pad && fwrite(zeros, 1, pad, f) != pad) return false;
+    offset += bytes + pad;
+    return true;
+}
+
+// files run to many GiB, and long is 32 bit on Windows
+static bool seekTo(FILE *f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (__int64) offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+// ================================================== class DatasetWriter
+const uint32_t DatasetHeader::VERSION;
+const uint32_t DatasetWriter::CHUNK_SAMPLES;
+
+void DatasetWriter::Chunk::reserve(size_t samples, size_t boardBytes) {
+    count = 0;
+    board.resize(samples * boardBytes);
+    cur.resize(samples);
+    nxt.resize(samples);
+    rot.resize(samples);
+    x.resize(samples);
+    y.resize(samples);
+    lines.resize(samples);
+    gain.resize(samples);
+}
+
+DatasetWriter::~DatasetWriter() {
+    close();
+}
+
+bool DatasetWriter::open(const char *path, int height, int width, uint32_t chunkSamples) {
+    close();
+    if (height < 1 || height > engine::MAX_HEIGHT || width < engine::PIECE_SIZE || width > engine::MAX_WIDTH ||
+        !chunkSamples) {
+        return false;
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    // columns go out in large pieces anyway, and unbuffered a failed write leaves nothing behind to flush in close
+    setvbuf(f, nullptr, _IONBF, 0);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = DatasetHeader::VERSION;
+    header.headerSize = sizeof(DatasetHeader);
+    header.height = height;
+    header.width = width;
+    header.rowBytes = (uint32_t) (width + 7) / 8;
+    header.chunkSamples = chunkSamples;
+    if (fwrite(&header, sizeof(header), 1, f) != 1) {
+        fclose(f);
+        return false;
+    }
+
+    file = f;
+    index.clear();
+    offset = sizeof(header);
+    failed = false;
+    for (auto &b: buffers) b.reserve(chunkSamples, (size_t) height * header.rowBytes);
+    front = &buffers[0];
+    back = &buffers[1];
+    backFull = false;
+    stored = 0;
+    lost = 0;
+    running = true;
+    writer = std::thread(&DatasetWriter::writerThread, this);
+    return true;
+}
+
+bool DatasetWriter::close() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!running) return false;
+        if (front->count) {
+            cond.wait(lock, [this] { return !backFull; });
+            handOff();
+        }
+        running = false;
+        cond.notify_all();
+    }
+    writer.join();
+
+    // the index goes after the last chunk that was written, over whatever a failed one left behind,
+    // then the header learns where it is. So the file holds exactly the samples it counts
+    header.sampleNum = stored;
+    header.chunkNum = index.size();
+    header.indexOffset = offset;
+    bool ok = seekTo(file, offset) &&
+              writePadded(file, index.data(), index.size() * sizeof(DatasetIndexEntry), offset) &&
+              seekTo(file, 0) && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok && !failed;
+    file = nullptr;
+    return ok;
+}
+
+bool DatasetWriter::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+bool DatasetWriter::append(const engine::Board &before, const engine::Piece &landed, int nxt, int lines,
+                           unsigned int gain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running || before.height != header.height || before.width != header.width) return false;
+    if (front->count == header.chunkSamples) {
+        if (backFull) {
+            ++lost;
+            return false;
+        }
+        handOff();
+    }
+
+    Chunk &c = *front;
+    uint32_t i = c.count++;
+    uint8_t *cells = c.board.data() + (size_t) i * header.height * header.rowBytes;
+    for (int r = 0; r < header.height; ++r) {
+        engine::row_t row = before.rows[r];
+        for (uint32_t b = 0; b < header.rowBytes; ++b, row >>= 8) *cells++ = (uint8_t) row;
+    }
+    c.cur[i] = (uint8_t) landed.kind;
+    c.nxt[i] = (uint8_t) nxt;
+    c.rot[i] = landed.rot;
+    c.x[i] = landed.x;
+    c.y[i] = landed.y;
+    c.lines[i] = (uint8_t) lines;
+    c.gain[i] = gain;
+
+    // hand off right away, so a finished chunk does not wait for the next sample
+    if (c.count == header.chunkSamples && !backFull) handOff();
+    return true;
+}
+
+uint64_t DatasetWriter::written() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stored;
+}
+
+uint64_t DatasetWriter::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lost;
+}
+
+void DatasetWriter::handOff() {
+    std::swap(front, back);
+    backFull = true;
+    cond.notify_all();
+}
+
+void DatasetWriter::writerThread() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return backFull || !running; });
+        if (!backFull) break;
+
+        // back is ours until backFull is cleared, append only touches front
+        lock.unlock();
+        bool ok = !failed && writeChunk(*back);
+        lock.lock();
+        if (ok) stored += back->count;
+        else failed = true;
+        back->count = 0;
+        backFull = false;
+        cond.notify_all();
+    }
+}
+
+bool DatasetWriter::writeChunk(const Chunk &c) {
+    DatasetIndexEntry e{};
+    e.offset = offset;
+    e.first = index.empty() ? 0 : index.back().first + index.back().count;
+    e.count = c.count;
+
+    DatasetChunk head{};
+    memcpy(head.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    head.count = c.count;
+    bool ok = writePadded(file, &head, sizeof(head), offset) &&
+              writePadded(file, c.board.data(), (size_t) c.count * header.height * header.rowBytes, offset) &&
+              writePadded(file, c.cur.data(), c.count, offset) &&
+              writePadded(file, c.nxt.data(), c.count, offset) &&
+              writePadded(file, c.rot.data(), c.count, offset) &&
+              writePadded(file, c.x.data(), c.count, offset) &&
+              writePadded(file, c.y.data(), c.count, offset) &&
+              writePadded(file, c.lines.data(), c.count, offset) &&
+              writePadded(file, c.gain.data(), (size_t) c.count * sizeof(uint32_t), offset);
+    if (!ok) return false;
+
+    e.bytes = (uint32_t) (offset - e.offset);
+    index.push_back(e);
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef TETRIS_DATASET_H
+#define TETRIS_DATASET_H
+
+#include "engine.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris {
+    // ================================================== struct DatasetHeader
+    // Fixed binary layout: header, chunks, then chunkNum index entries at indexOffset.
+    // indexOffset stays 0 until the file is closed, the chunks of an unfinished file can still be walked one by one.
+    struct DatasetHeader {
+        const static uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        int32_t height; // board size in cells
+        int32_t width;
+        uint32_t rowBytes; // a board row is stored in its low rowBytes bytes, little-endian
+        uint32_t chunkSamples; // capacity of a chunk, the last one may hold less
+        uint64_t sampleNum;
+        uint64_t chunkNum;
+        uint64_t indexOffset;
+    };
+
+    // Every chunk starts with this, followed by one column per field, each padded to 8 bytes:
+    // board (count * height * rowBytes, the board before the piece lands), cur, nxt (piece kinds),
+    // rot, x, y (where cur came to rest, engine::Piece coordinates), lines (cleared), gain (uint32_t, score)
+    struct DatasetChunk {
+        char magic[4];
+        uint32_t count;
+    };
+
+    struct DatasetIndexEntry {
+        uint64_t offset; // of the DatasetChunk
+        uint64_t first; // number of the first sample
+        uint32_t count;
+        uint32_t bytes; // chunk header included
+    };
+
+    // ================================================== class DatasetWriter
+    // Collects one sample per landed piece into column buffers. A full chunk is handed to a writer thread
+    // and filling goes on in the other buffer, so append never waits for the disk.
+    // When the writer is still busy with the previous chunk the sample is dropped and counted instead.
+    class DatasetWriter {
+    public:
+        const static uint32_t CHUNK_SAMPLES = 4096;
+
+        DatasetWriter() = default;
+        DatasetWriter(const DatasetWriter &) = delete;
+        DatasetWriter &operator=(const DatasetWriter &) = delete;
+        ~DatasetWriter();
+
+        // the file is replaced, all samples must have this board size
+        bool open(const char *path, int height, int width, uint32_t chunkSamples = CHUNK_SAMPLES);
+        // flush what is left, write the index and the final header, false on any write error
+        bool close();
+        bool isOpen() const;
+
+        // thread safe, false if the sample was dropped
+        bool append(const engine::Board &before, const engine::Piece &landed, int nxt, int lines, unsigned int gain);
+
+        uint64_t written() const; // samples in chunks that made it to the file
+        uint64_t dropped() const;
+
+    private:
+        struct Chunk {
+            uint32_t count = 0;
+            std::vector<uint8_t> board;
+            std::vector<uint8_t> cur;
+            std::vector<uint8_t> nxt;
+            std::vector<int8_t> rot;
+            std::vector<int8_t> x;
+            std::vector<int8_t> y;
+            std::vector<uint8_t> lines;
+            std::vector<uint32_t> gain;
+
+            void reserve(size_t samples, size_t boardBytes);
+        };
+
+        void writerThread();
+        bool writeChunk(const Chunk &c);
+        void handOff(); // with mutex held
+
+    private:
+        FILE *file = nullptr;
+        DatasetHeader header{};
+        std::vector<DatasetIndexEntry> index; // writer thread only
+        uint64_t offset = 0; // writer thread only
+        bool failed = false; // writer thread only
+
+        Chunk buffers[2];
+        Chunk *front = &buffers[0]; // filled by append
+        Chunk *back = &buffers[1]; // written by the writer thread while full
+        bool backFull = false;
+        bool running = false;
+        uint64_t stored = 0; // samples whose chunk was written
+        uint64_t lost = 0;
+        mutable std::mutex mutex;
+        std::condition_variable cond;
+        std::thread writer;
+    };
+}
+
+#endif //TETRIS_DATASET_H
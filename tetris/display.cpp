@@ -1,15 +1,405 @@
 #include "display.h"
 #include <ncursesw/ncurses.h>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
 
 using namespace display;
 
+// ================================================== local variables
+// Output goes through a pipe and a pump thread, so every byte sent to the terminal is counted
+// and, in low bandwidth mode, held back once the frame has used its budget.
+static const unsigned long long UNLIMITED = ~0ULL;
+static SCREEN *Screen = nullptr;
+static FILE *OutFile = nullptr;
+static int OutPipe[2] = {-1, -1};
+static std::thread OutPump;
+static std::mutex OutMutex; // never held while writing to the terminal
+static std::atomic<unsigned long long> PumpedBytes{0}; // written to the terminal
+static std::string OutBacklog; // guarded by OutMutex, read from the pipe and not written yet
+static unsigned long long OutAllowance = UNLIMITED; // guarded by OutMutex, what the current frame may still write
+static int GrantPipe[2] = {-1, -1}; // wakes the pump when a frame grants output
+#ifndef _WIN32
+static struct termios OrigTermios;
+#endif
+
+// frame accounting and low bandwidth mode, only touched by the render thread
+static bool LowBandwidth = false;
+static unsigned int FrameBudget = 0;
+static unsigned long long FrameStartBytes = 0;
+static WINDOW *InputWin = nullptr;
+static int MaxY = 0;
+static int MaxX = 0;
+static std::mutex StatsMutex;
+static OutputStats Stats; // guarded by StatsMutex
+
+// Every curses call runs on the render thread. Callers post commands to a lock-free queue and return at once,
+// the render thread runs them in order and sends the result to the terminal at the end of each frame.
+// The queue is a ring of slots allocated once: a push allocates nothing but what the command itself captures,
+// and when the render thread falls a whole ring behind, callers wait for it instead of piling up commands.
+struct Command {
+    std::atomic<size_t> seq{0}; // position + 1 once filled, position + QUEUE_SIZE once free again
+    std::function<void()> fn;
+};
+
+static const int IDLE_FLUSH_MS = 2; // drawing outside of frames is sent once the queue stays empty this long
+static const int INPUT_POLL_MS = 50;
+static const size_t QUEUE_SIZE = 4096; // a power of two
+static Command Queue[QUEUE_SIZE];
+static std::atomic<size_t> QueueHead{0}; // next position producers fill
+static size_t QueueTail = 0; // next position the render thread runs
+static std::thread RenderThread;
+static std::atomic<bool> Rendering{false};
+static std::atomic<bool> RenderStop{false};
+static std::atomic<bool> RenderSleeping{false};
+#ifndef _WIN32
+static int WakePipe[2] = {-1, -1};
+#endif
+
+// keys read by the render thread
+static std::mutex InputMutex;
+static std::condition_variable InputCond;
+static std::deque<int> InputKeys; // guarded by InputMutex
+static std::atomic<bool> InputDelay{true};
+static std::atomic<bool> LowBandwidthSet{false}; // what callers asked for, LowBandwidth follows in order
+
 // ================================================== local functions
 static inline WINDOW *W(void *ptr) {
     return (WINDOW *) ptr;
 }
 
+// updates only reach the virtual screen, the render thread sends them once per frame
+static inline void refreshW(WINDOW *win) {
+    wnoutrefresh(win);
+}
+
+static unsigned long long sentBytes() {
+    return PumpedBytes;
+}
+
+// curses output the current frame can not send: over the budget or still in the pipe
+static bool outputPending() {
+    std::lock_guard<std::mutex> lock(OutMutex);
+    int pending = 0;
+#ifndef _WIN32
+    if (OutPipe[0] >= 0) ioctl(OutPipe[0], FIONREAD, &pending);
+#endif
+    return OutBacklog.size() > OutAllowance || pending > 0;
+}
+
+#ifndef _WIN32
+// write as much of the backlog as the frame allows. Only the pump writes, and the slice is taken under
+// OutMutex but written without it, so a slow terminal never blocks the render thread on the lock
+static void writeBacklog() {
+    std::string slice;
+    {
+        std::lock_guard<std::mutex> lock(OutMutex);
+        size_t n = (size_t) std::min((unsigned long long) OutBacklog.size(), OutAllowance);
+        slice.assign(OutBacklog, 0, n);
+        OutBacklog.erase(0, n);
+        if (OutAllowance != UNLIMITED) OutAllowance -= n;
+    }
+    size_t off = 0;
+    while (off < slice.size()) {
+        ssize_t w = write(STDOUT_FILENO, slice.data() + off, slice.size() - off);
+        if (w <= 0) break;
+        off += w;
+        PumpedBytes += w;
+    }
+}
+
+// wakes up for curses output and for grants, until the pipe is closed
+static void pumpOutput() {
+    char buf[4096];
+    while (true) {
+        pollfd fds[2] = {{OutPipe[0], POLLIN, 0}, {GrantPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            if (read(GrantPipe[0], drain, sizeof(drain)) < 0) {}
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read(OutPipe[0], buf, sizeof(buf));
+            if (n <= 0) break;
+            std::lock_guard<std::mutex> lock(OutMutex);
+            OutBacklog.append(buf, n);
+        }
+        writeBacklog();
+    }
+    {
+        std::lock_guard<std::mutex> lock(OutMutex);
+        OutAllowance = UNLIMITED;
+    }
+    writeBacklog();
+}
+
+// a new frame may write `allowance` bytes, starting with what earlier frames held back
+static void grantOutput(unsigned long long allowance) {
+    {
+        std::lock_guard<std::mutex> lock(OutMutex);
+        OutAllowance = allowance;
+    }
+    char c = 0;
+    if (GrantPipe[1] >= 0 && write(GrantPipe[1], &c, 1) < 0) {} // a full pipe is already a wake up
+}
+
+// terminal modes are set on the real terminal, ncurses only sees the pipe
+static bool startCountedScreen() {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || pipe(OutPipe)) return false;
+    if (pipe(GrantPipe)) {
+        close(OutPipe[0]);
+        close(OutPipe[1]);
+        OutPipe[0] = OutPipe[1] = -1;
+        return false;
+    }
+    fcntl(GrantPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(GrantPipe[1], F_SETFL, O_NONBLOCK);
+
+    struct winsize ws{};
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
+    if (ws.ws_row && ws.ws_col) {
+        setenv("LINES", std::to_string(ws.ws_row).c_str(), 1);
+        setenv("COLUMNS", std::to_string(ws.ws_col).c_str(), 1);
+    }
+    tcgetattr(STDIN_FILENO, &OrigTermios);
+    struct termios raw = OrigTermios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+    OutFile = fdopen(OutPipe[1], "w");
+    Screen = OutFile ? newterm(nullptr, OutFile, stdin) : nullptr;
+    if (!Screen) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &OrigTermios);
+        if (OutFile) fclose(OutFile);
+        else close(OutPipe[1]);
+        close(OutPipe[0]);
+        OutFile = nullptr;
+        OutPipe[0] = OutPipe[1] = -1;
+        close(GrantPipe[0]);
+        close(GrantPipe[1]);
+        GrantPipe[0] = GrantPipe[1] = -1;
+        return false;
+    }
+    OutPump = std::thread(pumpOutput);
+    return true;
+}
+#else
+static void grantOutput(unsigned long long) {}
+#endif
+
+static void sendFrame();
+
+static void stopScreen() {
+    endwin();
+    if (!Screen) return;
+    delscreen(Screen);
+    Screen = nullptr;
+#ifndef _WIN32
+    fclose(OutFile); // pump sees EOF
+    OutFile = nullptr;
+    OutPump.join();
+    close(OutPipe[0]);
+    OutPipe[0] = OutPipe[1] = -1;
+    close(GrantPipe[0]);
+    close(GrantPipe[1]);
+    GrantPipe[0] = GrantPipe[1] = -1;
+    tcsetattr(STDIN_FILENO, TCSANOW, &OrigTermios);
+#endif
+}
+
+static void wakeRender() {
+    if (RenderSleeping.exchange(false)) {
+#ifndef _WIN32
+        char c = 0;
+        if (write(WakePipe[1], &c, 1) < 0) {} // a full pipe is already a wake up
+#endif
+    }
+}
+
+// Vyukov's bounded multi-producer queue: a push claims a slot with one compare-exchange,
+// the render thread is the only consumer
+static void post(std::function<void()> fn) {
+    if (!Rendering) { // before initDisplay() or after destroyDisplay()
+        fn();
+        return;
+    }
+    size_t pos = QueueHead.load(std::memory_order_relaxed);
+    Command *cmd;
+    while (true) {
+        cmd = &Queue[pos & (QUEUE_SIZE - 1)];
+        auto diff = (std::ptrdiff_t) (cmd->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (QueueHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) { // full, the render thread is a whole ring behind
+            wakeRender();
+            std::this_thread::yield();
+            pos = QueueHead.load(std::memory_order_relaxed);
+        } else {
+            pos = QueueHead.load(std::memory_order_relaxed);
+        }
+    }
+    cmd->fn = std::move(fn);
+    cmd->seq.store(pos + 1); // seq_cst, so the render thread either sees it or is told to wake
+    wakeRender();
+}
+
+static bool queued() {
+    return Queue[QueueTail & (QUEUE_SIZE - 1)].seq.load() == QueueTail + 1;
+}
+
+// run on the render thread and wait, for calls whose result is needed at once
+static void postSync(const std::function<void()> &fn) {
+    if (!Rendering || std::this_thread::get_id() == RenderThread.get_id()) {
+        fn();
+        return;
+    }
+    std::promise<void> done;
+    post([&] {
+        fn();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+static bool popCommand() {
+    if (!queued()) return false;
+    Command &cmd = Queue[QueueTail & (QUEUE_SIZE - 1)];
+    std::function<void()> fn = std::move(cmd.fn);
+    cmd.fn = nullptr;
+    cmd.seq.store(QueueTail + QUEUE_SIZE, std::memory_order_release);
+    ++QueueTail;
+    fn();
+    return true;
+}
+
+static void readInput() {
+    int ch;
+    bool got = false;
+    while ((ch = wgetch(InputWin)) != ERR) {
+        std::lock_guard<std::mutex> lock(InputMutex);
+        InputKeys.push_back(ch);
+        got = true;
+    }
+    if (got) InputCond.notify_all();
+}
+
+// sleep until a command is posted, a key is pressed or ms pass. Return true if there may be commands
+static bool waitForWork(int ms) {
+    RenderSleeping = true;
+    if (queued()) {
+        RenderSleeping = false;
+        return true;
+    }
+#ifdef _WIN32
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(ms, 1)));
+    RenderSleeping = false;
+    return true;
+#else
+    pollfd fds[2] = {{WakePipe[0], POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    poll(fds, 2, ms);
+    RenderSleeping = false;
+    if (fds[0].revents & POLLIN) {
+        char buf[64];
+        if (read(WakePipe[0], buf, sizeof(buf)) < 0) {}
+    }
+    return queued();
+#endif
+}
+
+static void renderLoop() {
+    bool dirty = false; // something drawn and not sent yet
+    while (true) {
+        while (popCommand()) dirty = true;
+        readInput();
+        if (RenderStop && !queued()) break;
+
+        // drawing outside of frames (messages, menus) is sent once it settles, endFrame() sends the rest
+        if (dirty && !LowBandwidth) {
+            if (!waitForWork(IDLE_FLUSH_MS)) {
+                sendFrame();
+                dirty = false;
+            }
+            continue;
+        }
+        waitForWork(INPUT_POLL_MS);
+    }
+}
+
+static void startRenderThread() {
+#ifndef _WIN32
+    if (pipe(WakePipe)) WakePipe[0] = WakePipe[1] = -1;
+    if (WakePipe[0] >= 0) {
+        fcntl(WakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(WakePipe[1], F_SETFL, O_NONBLOCK);
+    }
+#endif
+    for (size_t i = 0; i < QUEUE_SIZE; ++i) Queue[i].seq.store(i, std::memory_order_relaxed);
+    QueueHead = 0;
+    QueueTail = 0;
+    nodelay(InputWin, true);
+    RenderStop = false;
+    Rendering = true;
+    RenderThread = std::thread(renderLoop);
+}
+
+static void stopRenderThread() {
+    if (!Rendering) return;
+    post([] { RenderStop = true; });
+    RenderThread.join();
+    Rendering = false;
+#ifndef _WIN32
+    close(WakePipe[0]);
+    close(WakePipe[1]);
+    WakePipe[0] = WakePipe[1] = -1;
+#endif
+    std::lock_guard<std::mutex> lock(InputMutex);
+    InputKeys.clear();
+}
+
+// on the render thread: close the last frame's accounting and send this one. Every update goes out here.
+// In low bandwidth mode no frame writes more than the budget to the terminal. An update larger than that
+// is split over the following frames, and new drawing is held in curses until the backlog is gone.
+static void sendFrame() {
+    unsigned long long total = sentBytes();
+    {
+        std::lock_guard<std::mutex> lock(StatsMutex);
+        Stats.totalBytes = total;
+        Stats.lastFrameBytes = total - FrameStartBytes;
+        Stats.maxFrameBytes = std::max(Stats.maxFrameBytes, Stats.lastFrameBytes);
+        ++Stats.frames;
+    }
+    FrameStartBytes = total;
+
+    if (LowBandwidth) {
+        grantOutput(FrameBudget);
+        if (outputPending()) {
+            std::lock_guard<std::mutex> lock(StatsMutex);
+            ++Stats.deferredFrames;
+            return;
+        }
+    }
+    doupdate();
+}
+
 static inline bool inWin(void *win, int y, int x) {
     int maxY, maxX;
     getmaxyx(W(win), maxY, maxX);
@@ -21,9 +411,13 @@ const int display::GETCH_ERR = ERR;
 
 // ================================================== functions
 RET_CODE display::initDisplay() {
+#ifdef _WIN32
     initscr();
+#else
+    if (!startCountedScreen()) initscr();
+#endif
     if (!has_colors()) {
-        endwin();
+        stopScreen();
         return DIS_NO_COLOR;
     }
     noecho();
@@ -38,15 +432,32 @@ RET_CODE display::initDisplay() {
     init_pair(PURE_CYAN, COLOR_CYAN, COLOR_CYAN);
     init_pair(PURE_WHITE, COLOR_WHITE, COLOR_WHITE);
     refresh();
+    // keys are read from a window never drawn on, so reading does not refresh anything
+    InputWin = newwin(1, 1, 0, 0);
+    if (!InputWin) {
+        stopScreen();
+        return DIS_ERR_CREATE_WIN;
+    }
+    untouchwin(InputWin);
+    getmaxyx(stdscr, MaxY, MaxX);
+    FrameStartBytes = sentBytes();
+    startRenderThread();
     return DIS_OK;
 }
 
 void display::destroyDisplay() {
-    endwin();
+    stopRenderThread();
+    if (InputWin) {
+        delwin(InputWin);
+        InputWin = nullptr;
+    }
+    LowBandwidth = false;
+    stopScreen();
 }
 
 void display::getMaxYX(int &y, int &x) {
-    getmaxyx(stdscr, y, x);
+    y = MaxY;
+    x = MaxX;
 }
 
 void *display::getGlobalWin() {
@@ -54,29 +465,91 @@ void *display::getGlobalWin() {
 }
 
 int display::d_wgetchar(void *win) {
-    return wgetch(W(win));
+    if (!Rendering) return wgetch(W(win));
+
+    // keys come from the render thread, win only matters to curses
+    std::unique_lock<std::mutex> lock(InputMutex);
+    if (InputKeys.empty()) {
+        if (!InputDelay) return ERR;
+        // a blocking read shows everything first
+        lock.unlock();
+        post(sendFrame);
+        lock.lock();
+        InputCond.wait(lock, [] { return !InputKeys.empty(); });
+    }
+    int ch = InputKeys.front();
+    InputKeys.pop_front();
+    return ch;
 }
 
 int display::d_wprintw(void *win, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    int r = vw_printw(W(win), fmt, args);
+    char buf[256];
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
-    return r;
+    if (n < 0) return ERR;
+
+    std::string text(buf, std::min((size_t) n, sizeof(buf) - 1));
+    if (n >= (int) sizeof(buf)) {
+        text.resize(n);
+        va_start(args, fmt);
+        vsnprintf(&text[0], n + 1, fmt, args);
+        va_end(args);
+    }
+    post([win, text] {
+        waddstr(W(win), text.c_str());
+        wnoutrefresh(W(win)); // input no longer goes through win, so nothing else would refresh it
+    });
+    return OK;
 }
 
 int display::d_wmove(void *win, int y, int x) {
-    return wmove(W(win), y, x);
+    post([win, y, x] { wmove(W(win), y, x); });
+    return OK;
 }
 
 void display::d_wrefresh(void *win) {
-    wrefresh(W(win));
+    post([win] { refreshW(W(win)); });
+}
+
+void display::d_doupdate() {
+    post(sendFrame);
 }
 
 void display::nodelay(void *win, bool enable) {
-    nodelay(W(win), enable);
+    if (!Rendering) nodelay(W(win), enable);
+    InputDelay = !enable;
+}
+
+void display::setLowBandwidth(bool enable, unsigned int bytesPerFrame) {
+    LowBandwidthSet = enable;
+    post([enable, bytesPerFrame] {
+        LowBandwidth = enable;
+        FrameBudget = bytesPerFrame;
+        grantOutput(enable ? bytesPerFrame : UNLIMITED);
+        {
+            std::lock_guard<std::mutex> lock(StatsMutex);
+            Stats.maxFrameBytes = 0; // the largest frame since the mode changed
+        }
+        if (!enable) sendFrame();
+    });
 }
 
+bool display::isLowBandwidth() {
+    return LowBandwidthSet;
+}
+
+void display::endFrame() {
+    post(sendFrame);
+}
+
+OutputStats display::getOutputStats() {
+    std::lock_guard<std::mutex> lock(StatsMutex);
+    return Stats;
+}
+
+
 // ================================================== class Tetrimino
 const int Tetrimino::HEIGHT;
 const int Tetrimino::WIDTH;
@@ -111,34 +584,34 @@ int Tetrimino::getX() const {
     return topLeftX;
 }
 
+// position and shape are copied, the object may have moved on by the time the command runs
 void Tetrimino::show(void *win, bool refreshNow) {
     isShowed = true;
-
-    wattrset(W(win), COLOR_PAIR(color));
-    for (int i = 0; i < HEIGHT; ++i) {
-        for (int j = 0; j < WIDTH; ++j) {
-            if (exist(i, j) && inWin(W(win), topLeftY + i, topLeftX + j)) {
-                mvwaddch(W(win), topLeftY + i, topLeftX + j, ' ');
-            }
-        }
-    }
-    wattroff(W(win), COLOR_PAIR(color));
-    if (refreshNow) wrefresh(W(win));
+    post([win, y = topLeftY, x = topLeftX, m = shapeMap, c = color, refreshNow] {
+        paint(W(win), y, x, m, COLOR_PAIR(c));
+        if (refreshNow) refreshW(W(win));
+    });
 }
 
 void Tetrimino::erase(void *win, bool refreshNow) {
     if (!isShowed) return;
     isShowed = false;
+    post([win, y = topLeftY, x = topLeftX, m = shapeMap, refreshNow] {
+        paint(W(win), y, x, m, A_NORMAL);
+        if (refreshNow) refreshW(W(win));
+    });
+}
 
-    wattrset(W(win), A_NORMAL);
+void Tetrimino::paint(void *win, int y, int x, map_t m, unsigned long attr) {
+    wattrset(W(win), (attr_t) attr);
     for (int i = 0; i < HEIGHT; ++i) {
         for (int j = 0; j < WIDTH; ++j) {
-            if (exist(i, j) && inWin(W(win), topLeftY + i, topLeftX + j)) {
-                mvwaddch(W(win), topLeftY + i, topLeftX + j, ' ');
+            if ((m >> (i * WIDTH + j) & 1) && inWin(W(win), y + i, x + j)) {
+                mvwaddch(W(win), y + i, x + j, ' ');
             }
         }
     }
-    if (refreshNow) wrefresh(W(win));
+    wattrset(W(win), A_NORMAL);
 }
 
 void Tetrimino::moveTo(void *win, int newY, int newX, bool refreshNow) {
@@ -146,7 +619,7 @@ void Tetrimino::moveTo(void *win, int newY, int newX, bool refreshNow) {
     topLeftY = newY;
     topLeftX = newX;
     show(win, false);
-    if (refreshNow) wrefresh(W(win));
+    if (refreshNow) post([win] { refreshW(W(win)); });
 }
 
 void Tetrimino::move(void *win, int offsetY, int offsetX, bool refreshNow) {
@@ -179,38 +652,47 @@ RET_CODE Field::startWin() {
     if (height < 3 || width < 3) {
         return DIS_ERR_CREATE_WIN;
     }
-    win = newwin(height, width, topLeftY, topLeftX);
-    if (!win) {
-        return DIS_ERR_CREATE_WIN;
-    }
-    subWin = subwin(W(win), iHeight, iWidth, iTopLeftY, iTopLeftX);
-    if (!subWin) {
-        return DIS_ERR_CREATE_WIN;
-    }
+    RET_CODE ret = DIS_OK;
+    postSync([&] {
+        win = newwin(height, width, topLeftY, topLeftX);
+        if (!win) {
+            ret = DIS_ERR_CREATE_WIN;
+            return;
+        }
+        subWin = subwin(W(win), iHeight, iWidth, iTopLeftY, iTopLeftX);
+        if (!subWin) {
+            ret = DIS_ERR_CREATE_WIN;
+            return;
+        }
 
-    // there is nothing to write on win directly after box created.
-    // otherwise we need touchwin(win) before wrefresh(subWin)
-    box(W(win), 0, 0);
-    wrefresh(W(win));
-    return DIS_OK;
+        // there is nothing to write on win directly after box created.
+        // otherwise we need touchwin(win) before wrefresh(subWin)
+        box(W(win), 0, 0);
+        refreshW(W(win));
+    });
+    return ret;
 }
 
 void Field::endWin() {
-    if (subWin) {
-        delwin(W(subWin));
-        subWin = nullptr;
-    }
-    if (win) {
-        wattrset(W(win), A_NORMAL);
-        wborder(W(win), ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ');
-        wrefresh(W(win));
-        delwin(W(win));
-        win = nullptr;
-    }
+    if (!win && !subWin) return;
+    // commands still queued may draw on the windows, so they are deleted in order
+    postSync([this] {
+        if (subWin) {
+            delwin(W(subWin));
+            subWin = nullptr;
+        }
+        if (win) {
+            wattrset(W(win), A_NORMAL);
+            wborder(W(win), ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ');
+            refreshW(W(win));
+            delwin(W(win));
+            win = nullptr;
+        }
+    });
 }
 
 void Field::refreshWin() {
-    wrefresh(W(subWin));
+    post([w = subWin] { refreshW(W(w)); });
 }
 
 void *Field::getWin() const {
@@ -238,7 +720,7 @@ void Field::getInnerYX(int &y, int &x) const {
 }
 
 void Field::enScroll(bool enable) {
-    scrollok(W(subWin), enable);
+    post([w = subWin, enable] { scrollok(W(w), enable); });
 }
 
 RET_CODE Field::startWin(int y, int x, int h, int w) {
@@ -279,6 +761,10 @@ Color GameField::getColor(int y, int x) const {
 }
 
 GameField::check_res_t GameField::hitCheck(int offsetY, int offsetX, const Tetrimino &t, bool includeTop) const {
+    // the kernel answers the common case, a piece that fits, anything else is worked out cell by cell for the flags
+    engine::Piece p{};
+    if (ops && toPiece(offsetY, offsetX, t, p) && ops->fits(cells, p, includeTop)) return CHECK_OK;
+
     check_res_t result = CHECK_OK;
     int y, x;
     t.getPos(y, x);
@@ -303,22 +789,32 @@ GameField::check_res_t GameField::hitCheck(int offsetY, int offsetX, const Tetri
     return result;
 }
 
+void GameField::getStartPoint(int &y, int &x) const {
+    y = iTopLeftY - Tetrimino::HEIGHT;
+    x = (iWidth - Tetrimino::WIDTH) / 2 & ~1; // even, so cells start at the left wall
+}
+
 void GameField::moveTetrisToStartPoint(Tetrimino &t, bool refreshNow) {
-    t.moveTo(subWin, iTopLeftY - Tetrimino::HEIGHT, iTopLeftX + (iWidth - Tetrimino::WIDTH) / 2, refreshNow);
+    int y, x;
+    getStartPoint(y, x);
+    t.moveTo(subWin, y, x, refreshNow);
 }
 
 
 void GameField::hideLine(int line, bool hide, bool refreshNow) {
     if (line < 0 || line >= iHeight) return;
 
-    if (hide) wattrset(W(subWin), A_NORMAL);
-    for (int j = 0; j < iWidth; ++j) {
-        if (map[line][j] != INVALID_COLOR) {
-            if (!hide) wattrset(W(subWin), COLOR_PAIR(map[line][j]));
-            mvwaddch(W(subWin), line, j, ' ');
+    post([w = subWin, line, colors = map[line], hide, refreshNow] {
+        wattrset(W(w), A_NORMAL);
+        for (int j = 0; j < (int) colors.size(); ++j) {
+            if (colors[j] != INVALID_COLOR) {
+                if (!hide) wattrset(W(w), COLOR_PAIR(colors[j]));
+                mvwaddch(W(w), line, j, ' ');
+            }
         }
-    }
-    if (refreshNow) wrefresh(W(subWin));
+        wattrset(W(w), A_NORMAL);
+        if (refreshNow) refreshW(W(w));
+    });
 }
 
 void GameField::fall(int *lines, int lineNum, bool refreshNow) {
@@ -331,9 +827,14 @@ void GameField::fall(int *lines, int lineNum, bool refreshNow) {
     for (int i = 0; i < lineNum; ++i) {
         map.emplace_front(iWidth, INVALID_COLOR);
     }
+    for (int i = lineNum - 1; i >= 0; --i) { // top first, so the lines below keep their index
+        if (lines[i] >= cells.height) continue;
+        std::copy_backward(cells.rows, cells.rows + lines[i], cells.rows + lines[i] + 1);
+        cells.rows[0] = 0;
+    }
 
     print();
-    if (refreshNow) wrefresh(W(subWin));
+    if (refreshNow) refreshWin();
 }
 
 void GameField::add(const Tetrimino &t, bool needPrint, bool refreshNow) {
@@ -348,16 +849,23 @@ void GameField::add(const Tetrimino &t, bool needPrint, bool refreshNow) {
         for (int j = 0; j < w; ++j) {
             if (tMap >> (i * w + j) & 1) {
                 map[y + i][x + j] = color;
+                markCell(y + i, x + j);
             }
         }
     }
     if (needPrint) {
         print();
-        if (refreshNow) wrefresh(W(subWin));
+        if (refreshNow) refreshWin();
     }
 }
 
 int GameField::checkComplete(const Tetrimino &t, int *lineList) {
+    engine::Piece p{};
+    if (ops && toPiece(0, 0, t, p)) {
+        engine::Board b = cells; // the lines are only reported here, fall() removes them
+        return ops->clearLines(b, p, lineList);
+    }
+
     int res = 0;
     for (int i = Tetrimino::HEIGHT - 1; i >= 0; --i) {
         bool flag = false; // there is a part in this line in tetrimino
@@ -381,31 +889,167 @@ int GameField::checkComplete(const Tetrimino &t, int *lineList) {
     return res;
 }
 
+const uint64_t *GameField::getCellRows(int &h, int &w, int &origin) const {
+    h = iHeight;
+    w = cellWidth;
+    origin = cellOrigin;
+    return cells.height ? cells.rows : nullptr;
+}
+
+void GameField::exportMap(signed char *colors) const {
+    for (int i = 0; i < iHeight; ++i) {
+        for (int j = 0; j < iWidth; ++j) {
+            *colors++ = (signed char) map[i][j];
+        }
+    }
+}
+
+void GameField::importMap(const signed char *colors, bool refreshNow) {
+    erase();
+    for (int i = 0; i < iHeight; ++i) {
+        for (int j = 0; j < iWidth; ++j) {
+            signed char c = *colors++;
+            map[i][j] = c >= PURE_BLACK && c < PURE_COLOR_NUM ? (Color) c : INVALID_COLOR;
+        }
+    }
+    // a cell is two characters, half cells only come from a damaged file
+    for (auto &m: map) {
+        for (int j = cellOrigin; j + 1 < iWidth; j += 2) {
+            if ((m[j] == INVALID_COLOR) != (m[j + 1] == INVALID_COLOR)) m[j] = m[j + 1] = INVALID_COLOR;
+        }
+    }
+    cells.reset(cells.height, cells.width);
+    for (int i = 0; i < iHeight; ++i) {
+        for (int j = 0; j < iWidth; ++j) {
+            if (map[i][j] != INVALID_COLOR) markCell(i, j);
+        }
+    }
+    print();
+    if (refreshNow) refreshWin();
+}
+
 void GameField::initMap() {
     map.resize(iHeight);
     for (auto &m: map) {
         m.resize(iWidth, INVALID_COLOR);
     }
+
+    // pieces move two characters at a time, so cells always start on the parity of the start point
+    int y, x;
+    getStartPoint(y, x);
+    cellOrigin = x % 2;
+    cellWidth = (iWidth - cellOrigin) / 2;
+    bool fit = iHeight <= engine::MAX_HEIGHT && cellWidth <= engine::MAX_WIDTH;
+    cells.reset(fit ? iHeight : 0, fit ? cellWidth : 0);
+    ops = fit && !cellOrigin && cellWidth * 2 == iWidth ? &engine::kernelsFor(iHeight, cellWidth) : nullptr;
+}
+
+void GameField::markCell(int y, int x) {
+    int c = x - cellOrigin;
+    if (y < cells.height && c >= 0 && !(c % 2) && c / 2 < cells.width) cells.rows[y] |= (engine::row_t) 1 << (c / 2);
+}
+
+// the engine piece for t moved by the offset, false if it does not sit on the cell grid
+bool GameField::toPiece(int offsetY, int offsetX, const Tetrimino &t, engine::Piece &p) const {
+    int y = t.getY() + offsetY;
+    int x = t.getX() + offsetX - cellOrigin;
+    if (x % 2 || y < INT8_MIN || y > INT8_MAX || x / 2 < INT8_MIN || x / 2 > INT8_MAX) return false;
+
+    // fold every two characters into one cell, a lone character is no cell
+    Tetrimino::map_t m = t.getMap();
+    Tetrimino::map_t both = m & m >> 1 & 0x55555555u;
+    if (both != ((m | m >> 1) & 0x55555555u)) return false;
+    both = (both | both >> 1) & 0x33333333u;
+    both = (both | both >> 2) & 0x0F0F0F0Fu;
+    auto shape = (uint16_t) ((both & 0xF) | (both >> 4 & 0xF0) | (both >> 8 & 0xF00) | (both >> 12 & 0xF000));
+
+    int kind, rot;
+    if (!engine::findShape(shape, kind, rot)) return false;
+    p = engine::Piece{(int8_t) kind, (int8_t) rot, (int8_t) y, (int8_t) (x / 2)};
+    return true;
 }
 
 void GameField::print() {
-    for (int i = 0; i < iHeight; ++i) {
-        for (int j = 0; j < iWidth; ++j) {
-            if (map[i][j] != INVALID_COLOR) {
-                wattrset(W(subWin), COLOR_PAIR(map[i][j]));
-                mvwaddch(W(subWin), i, j, ' ');
-            }
-        }
-    }
+    paintMap(false);
 }
 
 void GameField::erase() {
-    wattrset(W(subWin), A_NORMAL);
-    for (int i = 0; i < iHeight; ++i) {
-        for (int j = 0; j < iWidth; ++j) {
-            if (map[i][j] != INVALID_COLOR) {
-                mvwaddch(W(subWin), i, j, ' ');
+    paintMap(true);
+}
+
+// the render thread gets a flat copy of the map as it is now
+void GameField::paintMap(bool blank) {
+    std::vector<signed char> cells((size_t) iHeight * iWidth);
+    exportMap(cells.data());
+    post([w = subWin, h = iHeight, wd = iWidth, cells = std::move(cells), blank] {
+        wattrset(W(w), A_NORMAL);
+        for (int i = 0; i < h; ++i) {
+            for (int j = 0; j < wd; ++j) {
+                signed char c = cells[(size_t) i * wd + j];
+                if (c == INVALID_COLOR) continue;
+                if (!blank) wattrset(W(w), COLOR_PAIR(c));
+                mvwaddch(W(w), i, j, ' ');
             }
         }
+        wattrset(W(w), A_NORMAL);
+    });
+}
+
+// ================================================== class MiniField
+void MiniField::getSize(int cellH, int cellW, int &h, int &w) {
+    h = (cellH + 1) / 2 + 2;
+    w = cellW + 2;
+}
+
+void MiniField::draw(const uint64_t *rows, int h, int w, const char *title) {
+    if (!win) return;
+    std::string newTitle;
+    if (strncmp(title, shownTitle, sizeof(shownTitle) - 1) != 0) {
+        strncpy(shownTitle, title, sizeof(shownTitle) - 1);
+        newTitle = shownTitle;
+    }
+
+    // pick the changed lines here, the render thread only gets their rows
+    int lines = std::min((h + 1) / 2, iHeight);
+    std::vector<std::pair<int, std::pair<uint64_t, uint64_t>>> changed;
+    if ((int) shown.size() != h) shown.assign(h, ~(uint64_t) 0); // force a full draw
+    for (int i = 0; i < lines; ++i) {
+        uint64_t top = rows[2 * i];
+        uint64_t bottom = 2 * i + 1 < h ? rows[2 * i + 1] : 0;
+        uint64_t &shownTop = shown[2 * i];
+        bool same = shownTop == top && (2 * i + 1 >= h || shown[2 * i + 1] == bottom);
+        if (same) continue;
+        shownTop = top;
+        if (2 * i + 1 < h) shown[2 * i + 1] = bottom;
+        changed.emplace_back(i, std::make_pair(top, bottom));
     }
+    if (newTitle.empty() && changed.empty()) return;
+
+    post([outer = win, inner = subWin, titleWidth = std::max(width - 2, 0), cols = std::min(w, iWidth),
+                 newTitle = std::move(newTitle), changed = std::move(changed)] {
+        if (!newTitle.empty()) {
+            wattrset(W(outer), A_NORMAL);
+            box(W(outer), 0, 0);
+            mvwaddnstr(W(outer), 0, 1, newTitle.c_str(), titleWidth);
+            wnoutrefresh(W(outer));
+        }
+        // both cells: a solid block, one of them: a half-height mark
+        for (auto &line: changed) {
+            uint64_t top = line.second.first;
+            uint64_t bottom = line.second.second;
+            for (int j = 0; j < cols; ++j) {
+                int t = (int) (top >> j & 1);
+                int b = (int) (bottom >> j & 1);
+                if (t && b) {
+                    wattrset(W(inner), COLOR_PAIR(PURE_WHITE));
+                    mvwaddch(W(inner), line.first, j, ' ');
+                } else {
+                    wattrset(W(inner), A_NORMAL);
+                    mvwaddch(W(inner), line.first, j, t ? '\'' : b ? '.' : ' ');
+                }
+            }
+        }
+        wattrset(W(inner), A_NORMAL);
+        wnoutrefresh(W(inner));
+    });
 }
@@ -1,6 +1,8 @@
 #ifndef TETRIS_DISPLAY_H
 #define TETRIS_DISPLAY_H
 
+#include "engine.h"
+#include <cstdint>
 #include <vector>
 #include <deque>
 
@@ -35,6 +37,14 @@ namespace display {
 
     extern const int GETCH_ERR;
 
+    struct OutputStats {
+        unsigned long long totalBytes = 0; // bytes sent to the terminal
+        unsigned long long frames = 0;
+        unsigned long long lastFrameBytes = 0;
+        unsigned long long maxFrameBytes = 0;
+        unsigned long long deferredFrames = 0; // frames held back by the low bandwidth budget
+    };
+
     // ================================================== functions
     RET_CODE initDisplay();
     void destroyDisplay();
@@ -44,7 +54,15 @@ namespace display {
     int d_wprintw(void *win, const char *fmt, ...);
     int d_wmove(void *win, int y, int x);
     void d_wrefresh(void *win);
+    // send everything drawn so far as a frame of its own, endFrame() does the same once per frame
+    void d_doupdate();
     void nodelay(void *win, bool enable);
+    // low bandwidth mode coalesces all drawing of a frame and sends it at endFrame(), never more than bytesPerFrame
+    // per frame: larger updates are split over the next frames and later drawing waits until they are out
+    void setLowBandwidth(bool enable, unsigned int bytesPerFrame = 0);
+    bool isLowBandwidth();
+    void endFrame();
+    OutputStats getOutputStats();
 
     // ================================================== class Tetrimino
     class Tetrimino {
@@ -71,6 +89,7 @@ namespace display {
         void moveWin(void *newWin, void *oldWin, int newY, int newX, bool refreshNow = true);
         void moveWithOutPrint(int newY, int newX);
 
+        static void paint(void *win, int y, int x, map_t m, unsigned long attr);
 
     protected:
         bool isShowed = false;
@@ -163,6 +182,7 @@ namespace display {
         Color getColor(int y, int x) const;
         check_res_t hitCheck(int offsetY, int offsetX, const Tetrimino &t, bool includeTop = false) const;
 
+        void getStartPoint(int &y, int &x) const;
         void moveTetrisToStartPoint(Tetrimino &t, bool refreshNow = true);
 
         void hideLine(int line, bool hide = true, bool refreshNow = true);
@@ -170,13 +190,46 @@ namespace display {
         void add(const Tetrimino &t, bool needPrint = false, bool refreshNow = false);
         int checkComplete(const Tetrimino &t, int *lineList);
 
+        // occupancy in cells: bit c of row y is the cell at character origin + 2c.
+        // Kept up to date with the map, nullptr if the field has more cells than an engine::Board.
+        const uint64_t *getCellRows(int &h, int &w, int &origin) const;
+
+        // copy the map to / from iHeight * iWidth colors, row-major
+        void exportMap(signed char *colors) const;
+        void importMap(const signed char *colors, bool refreshNow = true);
+
     protected:
         void initMap();
         void print();
         void erase();
+        void paintMap(bool blank);
+        void markCell(int y, int x);
+        bool toPiece(int offsetY, int offsetX, const Tetrimino &t, engine::Piece &p) const;
 
     protected:
         std::deque<std::vector<Color>> map;
+        engine::Board cells{}; // height 0 if the field does not fit
+        const engine::Kernels *ops = nullptr; // when cells cover the map exactly, hitCheck and checkComplete use it
+        int cellOrigin = 0;
+        int cellWidth = 0;
+    };
+
+    // ================================================== class MiniField
+    // A board at one character per cell and two cell rows per line, for watching many games at once.
+    class MiniField : public Field {
+    public:
+        MiniField() = default;
+
+        // outer size of a field showing h x w cells
+        static void getSize(int cellH, int cellW, int &h, int &w);
+
+        // occupancy rows as in GameField::getCellRows. Only lines that differ from the previous call are written,
+        // the update is staged and sent by the next d_doupdate()
+        void draw(const uint64_t *rows, int h, int w, const char *title);
+
+    protected:
+        std::vector<uint64_t> shown;
+        char shownTitle[32] = {};
     };
 }
 
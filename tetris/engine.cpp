@@ -0,0 +1,327 @@
+#include "engine.h"
+
+using namespace engine;
+
+// ================================================== local functions
+// same shapes as display::I, L, J, O, S, T, Z with every two characters folded into one cell
+static constexpr uint16_t SHAPES[KIND_NUM][4] = {
+        {0x0F00, 0x4444},
+        {0x0322, 0x0071, 0x0113, 0x0047},
+        {0x0311, 0x0017, 0x0223, 0x0074},
+        {0x0033},
+        {0x0360, 0x0231},
+        {0x0072, 0x0131, 0x0270, 0x0232},
+        {0x0630, 0x0132}
+};
+static constexpr int ROTATION_NUM[KIND_NUM] = {2, 4, 4, 1, 2, 4, 2};
+
+// shift a 4 bit shape row to column x, false if any cell leaves [0, width)
+static inline bool placeRow(row_t r, int x, int width, row_t &out) {
+    int lo = __builtin_ctzll(r);
+    int hi = 63 - __builtin_clzll(r);
+    if (x + lo < 0 || x + hi >= width) return false;
+    out = x >= 0 ? r << x : r >> -x;
+    return true;
+}
+
+// every shape shifted to every column of a board W cells wide, x runs from 1 - PIECE_SIZE to W - 1
+template <int W>
+struct ShapeTable {
+    static_assert(W <= 16, "rows are stored in 16 bit");
+
+    struct Entry {
+        uint16_t rows[PIECE_SIZE];
+        int8_t top; // first and last non-empty row
+        int8_t bottom;
+        bool ok; // all cells inside [0, W)
+    };
+
+    Entry at[KIND_NUM][4][W + PIECE_SIZE - 1];
+
+    constexpr ShapeTable() : at{} {
+        for (int kind = 0; kind < KIND_NUM; ++kind) {
+            for (int rot = 0; rot < ROTATION_NUM[kind]; ++rot) {
+                for (int x = 1 - PIECE_SIZE; x < W; ++x) {
+                    Entry &e = at[kind][rot][x + PIECE_SIZE - 1];
+                    e.top = -1;
+                    e.ok = true;
+                    for (int i = 0; i < PIECE_SIZE; ++i) {
+                        int r = (SHAPES[kind][rot] >> (i * PIECE_SIZE)) & 0xF;
+                        if (!r) continue;
+                        if (e.top < 0) e.top = (int8_t) i;
+                        e.bottom = (int8_t) i;
+                        int lo = 0, hi = PIECE_SIZE - 1;
+                        while (!(r >> lo & 1)) ++lo;
+                        while (!(r >> hi & 1)) --hi;
+                        if (x + lo < 0 || x + hi >= W) e.ok = false;
+                        else e.rows[i] = (uint16_t) (x >= 0 ? r << x : r >> -x);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Board methods for a board of exactly H x W, same results as the generic ones
+template <int H, int W>
+struct SizedBoard {
+    static_assert(H + PIECE_SIZE - 1 <= MAX_HEIGHT, "all four rows under a piece must be addressable");
+
+    static constexpr ShapeTable<W> table{};
+    static constexpr row_t FULL = ((row_t) 1 << W) - 1;
+
+    static const typename ShapeTable<W>::Entry *entry(const Piece &p) {
+        if (p.x < 1 - PIECE_SIZE || p.x >= W) return nullptr;
+        const auto *e = &table.at[p.kind][p.rot][p.x + PIECE_SIZE - 1];
+        return e->ok ? e : nullptr;
+    }
+
+    static bool fits(const Board &b, const Piece &p, bool includeTop) {
+        const auto *e = entry(p);
+        if (!e || p.y + e->bottom >= H) return false;
+        if (p.y >= 0) { // rows past the piece bottom are masked by empty shape rows
+            const row_t *r = b.rows + p.y;
+            return !((r[0] & e->rows[0]) | (r[1] & e->rows[1]) | (r[2] & e->rows[2]) | (r[3] & e->rows[3]));
+        }
+        if (includeTop && p.y + e->top < 0) return false;
+        for (int i = -p.y; i < PIECE_SIZE; ++i) {
+            if (b.rows[p.y + i] & e->rows[i]) return false;
+        }
+        return true;
+    }
+
+    static void place(Board &b, const Piece &p) {
+        const auto *e = entry(p);
+        if (!e) return b.place(p); // partly outside, only the generic code knows which rows to keep
+        for (int i = 0; i < PIECE_SIZE; ++i) {
+            int y = p.y + i;
+            if (y >= 0 && y < H) b.rows[y] |= e->rows[i];
+        }
+    }
+
+    static int clearLines(Board &b, const Piece &p, int *lineList) {
+        uint16_t shape = SHAPES[p.kind][p.rot];
+        int lines[PIECE_SIZE];
+        int n = 0;
+        for (int i = PIECE_SIZE - 1; i >= 0; --i) {
+            int y = p.y + i;
+            if (shapeRow(shape, i) && y >= 0 && y < H && b.rows[y] == FULL) lines[n++] = y;
+        }
+        if (!n) return 0;
+
+        int dst = lines[0];
+        for (int src = dst; src >= 0; --src) {
+            if (b.rows[src] != FULL) b.rows[dst--] = b.rows[src];
+        }
+        while (dst >= 0) b.rows[dst--] = 0;
+
+        if (lineList) {
+            for (int i = 0; i < n; ++i) lineList[i] = lines[i];
+        }
+        return n;
+    }
+
+    static constexpr Kernels kernels{fits, place, clearLines, true};
+};
+
+static bool genericFits(const Board &b, const Piece &p, bool includeTop) {
+    return b.fits(p, includeTop);
+}
+
+static void genericPlace(Board &b, const Piece &p) {
+    b.place(p);
+}
+
+static int genericClearLines(Board &b, const Piece &p, int *lineList) {
+    return b.clearLines(p, lineList);
+}
+
+static constexpr Kernels GENERIC_KERNELS{genericFits, genericPlace, genericClearLines, false};
+
+// ================================================== functions
+int engine::rotationNum(int kind) {
+    return ROTATION_NUM[kind];
+}
+
+uint16_t engine::shapeOf(int kind, int rot) {
+    return SHAPES[kind][rot];
+}
+
+bool engine::findShape(uint16_t shape, int &kind, int &rot) {
+    for (kind = 0; kind < KIND_NUM; ++kind) {
+        for (rot = 0; rot < ROTATION_NUM[kind]; ++rot) {
+            if (SHAPES[kind][rot] == shape) return true;
+        }
+    }
+    return false;
+}
+
+// ================================================== struct Board
+void Board::reset(int h, int w) {
+    height = h;
+    width = w;
+    for (auto &r: rows) r = 0;
+}
+
+bool Board::fits(const Piece &p, bool includeTop) const {
+    uint16_t shape = p.shape();
+    for (int i = 0; i < PIECE_SIZE; ++i) {
+        row_t r = shapeRow(shape, i);
+        if (!r) continue;
+        row_t cells;
+        if (!placeRow(r, p.x, width, cells)) return false;
+        int y = p.y + i;
+        if (y >= height) return false;
+        if (y < 0) {
+            if (includeTop) return false;
+            continue;
+        }
+        if (rows[y] & cells) return false;
+    }
+    return true;
+}
+
+void Board::place(const Piece &p) {
+    uint16_t shape = p.shape();
+    for (int i = 0; i < PIECE_SIZE; ++i) {
+        row_t r = shapeRow(shape, i);
+        int y = p.y + i;
+        row_t cells;
+        if (!r || y < 0 || y >= height || !placeRow(r, p.x, width, cells)) continue;
+        rows[y] |= cells;
+    }
+}
+
+int Board::clearLines(const Piece &p, int *lineList) {
+    uint16_t shape = p.shape();
+    row_t full = fullRow();
+    int lines[PIECE_SIZE];
+    int n = 0;
+    for (int i = PIECE_SIZE - 1; i >= 0; --i) {
+        int y = p.y + i;
+        if (shapeRow(shape, i) && y >= 0 && y < height && rows[y] == full) lines[n++] = y;
+    }
+    if (!n) return 0;
+
+    // only rows covered by the piece can be complete, so compact from the lowest one upwards
+    int dst = lines[0];
+    for (int src = dst; src >= 0; --src) {
+        if (rows[src] != full) rows[dst--] = rows[src];
+    }
+    while (dst >= 0) rows[dst--] = 0;
+
+    if (lineList) {
+        for (int i = 0; i < n; ++i) lineList[i] = lines[i];
+    }
+    return n;
+}
+
+uint64_t Board::hash() const {
+    uint64_t h = 0xCBF29CE484222325ULL ^ ((uint64_t) height << 32 | (uint32_t) width);
+    for (int y = 0; y < height; ++y) {
+        h = (h ^ rows[y]) * 0x100000001B3ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+// ================================================== struct Kernels
+// the standard 10 x 20 board, with the two hidden rows of modern rule sets, and the 10 x 40 guideline matrix
+const Kernels &engine::kernelsFor(int height, int width) {
+    if (width == 10) {
+        switch (height) {
+            case 20:
+                return SizedBoard<20, 10>::kernels;
+            case 22:
+                return SizedBoard<22, 10>::kernels;
+            case 40:
+                return SizedBoard<40, 10>::kernels;
+            default:
+                break;
+        }
+    }
+    return GENERIC_KERNELS;
+}
+
+// ================================================== class Game
+bool Game::reset(uint64_t seed, int height, int width) {
+    if (height < 1 || height > MAX_HEIGHT || width < PIECE_SIZE || width > MAX_WIDTH) return false;
+
+    st = State{};
+    st.board.reset(height, width);
+    ops = &kernelsFor(height, width);
+    st.rng.reseed(seed);
+    st.cur = draw();
+    st.nxt = draw();
+    return true;
+}
+
+unsigned int Game::step(int action) {
+    if (st.done) return 0;
+    act(action);
+
+    unsigned int gain = 0;
+    // time to fall
+    if (!(st.tick % TICK_PER_FALL)) {
+        Piece down = st.cur;
+        ++down.y;
+        if (ops->fits(st.board, down, false)) {
+            st.cur = down;
+        } else if (!ops->fits(st.board, st.cur, true)) { // Game Over
+            st.done = 1;
+        } else {
+            ops->place(st.board, st.cur);
+            unsigned int n = ops->clearLines(st.board, st.cur, nullptr);
+            gain = n * n * SCORE_BASE;
+            st.score += gain;
+            st.lines += n;
+            spawn();
+        }
+    }
+    ++st.tick;
+    return gain;
+}
+
+bool Game::act(int action) {
+    Piece p = st.cur;
+    switch (action) {
+        case ACT_LEFT:
+            --p.x;
+            break;
+        case ACT_RIGHT:
+            ++p.x;
+            break;
+        case ACT_DOWN: {
+            int offset = DOWN_STEP;
+            for (; offset; --offset) {
+                p.y = (int8_t) (st.cur.y + offset);
+                if (ops->fits(st.board, p, false)) break;
+            }
+            if (!offset) return false;
+            break;
+        }
+        case ACT_ROTATE:
+            p.rot = (int8_t) ((p.rot + 1) % rotationNum(p.kind));
+            break;
+        default:
+            return false;
+    }
+
+    if (!ops->fits(st.board, p, false)) return false;
+    st.cur = p;
+    return true;
+}
+
+Piece Game::draw() {
+    Piece p{};
+    p.kind = (int8_t) (st.rng.randint(RAND_NUM_MIN, RAND_NUM_MAX) % KIND_NUM);
+    p.rot = (int8_t) (st.rng.randint(RAND_NUM_MIN, RAND_NUM_MAX) % rotationNum(p.kind));
+    p.y = (int8_t) START_Y;
+    p.x = (int8_t) ((st.board.width - PIECE_SIZE) / 2);
+    return p;
+}
+
+void Game::spawn() {
+    st.cur = st.nxt;
+    st.nxt = draw();
+}
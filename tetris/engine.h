@@ -0,0 +1,124 @@
+#ifndef TETRIS_ENGINE_H
+#define TETRIS_ENGINE_H
+
+#include "random.h"
+#include <cstdint>
+
+// Headless game core: same rules as tetris::Tetris, but no terminal, no threads and no sleeping.
+// Everything is measured in cells (one cell is two characters on the terminal).
+namespace engine {
+    // ================================================== variables
+    typedef uint64_t row_t; // bit c of a row is column c
+
+    const int MAX_HEIGHT = 64;
+    const int MAX_WIDTH = 64;
+    const int DEFAULT_HEIGHT = 20;
+    const int DEFAULT_WIDTH = 10;
+    const int PIECE_SIZE = 4;
+    const int KIND_NUM = 7;
+    const int START_Y = 1 - PIECE_SIZE;
+
+    // keep in sync with tetris::Tetris
+    const unsigned long long TICK_PER_FALL = 8;
+    const unsigned int SCORE_BASE = 100;
+    const int DOWN_STEP = 5;
+    const int RAND_NUM_MIN = 0;
+    const int RAND_NUM_MAX = 27;
+
+    enum Action {
+        ACT_NONE = 0,
+        ACT_LEFT,
+        ACT_RIGHT,
+        ACT_DOWN,
+        ACT_ROTATE,
+        ACT_NUM
+    };
+
+    // ================================================== functions
+    // 4x4 shape in 16 bit, bit (i * 4 + j) is row i column j. Kinds follow Tetris::TetrisList: I L J O S T Z
+    int rotationNum(int kind);
+    uint16_t shapeOf(int kind, int rot);
+    // kind and rotation of a 4x4 shape, false if it is not one of them
+    bool findShape(uint16_t shape, int &kind, int &rot);
+
+    inline row_t shapeRow(uint16_t shape, int i) {
+        return (shape >> (i * PIECE_SIZE)) & 0xF;
+    }
+
+    // ================================================== struct Piece
+    struct Piece {
+        int8_t kind;
+        int8_t rot;
+        int8_t y;
+        int8_t x;
+
+        uint16_t shape() const { return shapeOf(kind, rot); }
+    };
+
+    // ================================================== struct Board
+    struct Board {
+        int32_t height;
+        int32_t width;
+        row_t rows[MAX_HEIGHT];
+
+        void reset(int h, int w);
+        row_t fullRow() const { return width >= 64 ? ~(row_t) 0 : ((row_t) 1 << width) - 1; }
+        // false if the piece hits a cell or leaves the board, cells above the top only count with includeTop
+        bool fits(const Piece &p, bool includeTop = false) const;
+        void place(const Piece &p);
+        // remove complete rows covered by the piece, lines are stored bottom-up, return the number of rows
+        int clearLines(const Piece &p, int *lineList = nullptr);
+        uint64_t hash() const;
+    };
+
+    // ================================================== struct Kernels
+    // Board::fits, place and clearLines compiled for one board size, so row loops unroll and bounds are constants.
+    // Standard sizes get specialized code, any other size gets the Board methods themselves.
+    struct Kernels {
+        bool (*fits)(const Board &b, const Piece &p, bool includeTop);
+        void (*place)(Board &b, const Piece &p);
+        int (*clearLines)(Board &b, const Piece &p, int *lineList);
+        bool sized; // false for the generic fallback
+    };
+
+    // pick once per board size, the result lives for the whole program
+    const Kernels &kernelsFor(int height, int width);
+
+    // ================================================== struct State
+    // Plain data, layout is mirrored by tetris_obs in tetris_env.h
+    struct State {
+        Board board;
+        Piece cur;
+        Piece nxt;
+        uint32_t score;
+        uint32_t lines;
+        uint64_t tick;
+        tetris::Random rng;
+        uint8_t done;
+    };
+
+    // ================================================== class Game
+    class Game {
+    public:
+        Game() = default;
+
+        bool reset(uint64_t seed, int height = DEFAULT_HEIGHT, int width = DEFAULT_WIDTH);
+        // one tick of Tetris::runningThread with the given key, return the score gained
+        unsigned int step(int action);
+        // apply only the key, no falling and no tick
+        bool act(int action);
+
+        const State &state() const { return st; }
+        State &state() { return st; }
+
+    private:
+        Piece draw();
+        void spawn();
+
+    private:
+        State st{};
+        const Kernels *ops = &kernelsFor(0, 0); // generic until reset picks the one for the board size
+    };
+}
+
+#endif //TETRIS_ENGINE_H
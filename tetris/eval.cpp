@@ -0,0 +1,69 @@
+#include "eval.h"
+
+using namespace engine;
+
+// ================================================== local functions
+static inline int popcount(row_t v) {
+    return __builtin_popcountll(v);
+}
+
+// depth counter of a well, one bit plane per binary digit, enough for MAX_HEIGHT
+static const int DEPTH_BITS = 7;
+static_assert((1 << DEPTH_BITS) > MAX_HEIGHT, "well depth planes do not cover MAX_HEIGHT");
+
+// ================================================== functions
+void engine::features(const row_t *rows, int height, int width, Features &f) {
+    f = Features{};
+    if (height < 1 || height > MAX_HEIGHT || width < 1 || width > MAX_WIDTH) return;
+
+    const row_t full = width >= 64 ? ~(row_t) 0 : ((row_t) 1 << width) - 1;
+    const row_t pairs = full >> 1; // column c paired with c + 1
+    const row_t leftWall = 1;
+    const row_t rightWall = (row_t) 1 << (width - 1);
+
+    row_t seen = 0; // columns with a filled cell at or above the current row
+    row_t prev = 0; // the row above, the sky is empty
+    row_t depth[DEPTH_BITS] = {};
+    const int depthBits = 32 - __builtin_clz((unsigned int) height);
+    bool inWell = false;
+
+    for (int y = 0; y < height; ++y) {
+        row_t r = rows[y] & full;
+        if (!(r | seen)) { // empty sky, only the walls change
+            f.rowTransitions += 2;
+            continue;
+        }
+
+        f.holes += popcount(~r & seen & full);
+        seen |= r;
+        if (seen && !f.maxHeight) f.maxHeight = height - y;
+
+        // a column of height h is counted at h rows, and two neighbours differ at |h1 - h2| rows
+        f.aggregateHeight += popcount(seen);
+        f.bumpiness += popcount((seen ^ (seen >> 1)) & pairs);
+
+        // walls as filled cells: left neighbour of column 0 and right neighbour of the last column
+        row_t left = (r << 1) | leftWall;
+        row_t right = (r >> 1) | rightWall;
+        f.rowTransitions += popcount((r ^ left) & full) + !(r & rightWall);
+        f.colTransitions += popcount(r ^ prev);
+        prev = r;
+
+        // open well cells: empty, nothing above, both sides filled
+        row_t well = ~r & ~seen & left & right & full;
+        if (well) {
+            row_t carry = well;
+            for (int b = 0; b < depthBits; ++b) { // depth = (depth + 1) in well columns, 0 elsewhere
+                row_t next = (depth[b] ^ carry) & well;
+                carry &= depth[b];
+                depth[b] = next;
+                f.wells += popcount(next) << b;
+            }
+            inWell = true;
+        } else if (inWell) {
+            for (int b = 0; b < depthBits; ++b) depth[b] = 0;
+            inWell = false;
+        }
+    }
+    f.colTransitions += popcount(prev ^ full);
+}
@@ -0,0 +1,28 @@
+#ifndef TETRIS_EVAL_H
+#define TETRIS_EVAL_H
+
+#include "engine.h"
+
+namespace engine {
+    // ================================================== struct Features
+    struct Features {
+        int aggregateHeight; // sum of column heights
+        int maxHeight;
+        int holes; // empty cells with a filled cell somewhere above
+        int bumpiness; // sum of height differences of neighbour columns
+        int rowTransitions; // filled / empty changes along rows, walls count as filled
+        int colTransitions; // filled / empty changes down columns, the floor counts as filled
+        int wells; // open cells between filled neighbours, a well of depth d adds 1 + 2 + ... + d
+    };
+
+    // ================================================== functions
+    // One pass from the top over an occupancy bitmap (bit c of rows[y] is column c, width up to 64).
+    // Each row is handled as a whole word, there is no per-cell loop. Boards over MAX_HEIGHT get all zero features.
+    void features(const row_t *rows, int height, int width, Features &f);
+
+    inline void features(const Board &b, Features &f) {
+        features(b.rows, b.height, b.width, f);
+    }
+}
+
+#endif //TETRIS_EVAL_H
@@ -0,0 +1,586 @@
+// End-to-end latency harness: run tetris in a pseudo-terminal, type keys on a fixed schedule and time when the
+// board shows the moves. Keys are sent at their scheduled time whatever the screen is doing, and screen updates
+// are matched to the keys as they come in.
+// The output stream is replayed on a small VT100 screen model that tracks which cells have a colored background.
+// At the end of every frame the colored cells per column of the game field are compared with the last frame:
+// falling keeps the columns, a move shifts them, and a piece coming into view, landing or clearing lines changes
+// the total. The game acts on the last key of a tick, so a shift is matched to the newest waiting key of its
+// direction and the keys before it did not move the piece (still above the field, at a wall, or overtaken),
+// just as keys that wait longer than a second.
+//
+// usage: tetris_latency <tetris binary> [-s script] [-n keys] [-i interval ms] [-l p99 limit ms]
+//   script: one "<ms> <key>" per line, the time counted from the game start, '#' starts a comment.
+//           Without one, -n keys alternate between left and right every -i ms, so the piece swings in place.
+//   Only a (left) and d (right) are timed, other keys are sent as scheduled.
+//   With -l the exit status is 1 if the p99 latency is above the limit or less than half the timed keys were seen.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    typedef std::chrono::steady_clock clock_type;
+
+    const int ROWS = 30;
+    const int COLS = 90;
+    const long long BURST_GAP_US = 2000; // output closer than this belongs to the same frame
+    const long long KEY_TIMEOUT_US = 1000000; // a key not shown by then did not move the piece
+    const long long DRAIN_US = 500000; // keep watching after the last key
+
+    long long nowUs() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(clock_type::now().time_since_epoch()).count();
+    }
+
+    // ================================================== class Screen
+    // just enough of a VT100 / xterm to follow what ncurses writes, attributes are ignored
+    class Screen {
+    public:
+        Screen(int rows, int cols)
+                : rows(rows), cols(cols), cells(rows, std::string(cols, ' ')), paint(rows, std::string(cols, ' ')),
+                  bottom(rows - 1) {}
+
+        void feed(const char *buf, size_t len) {
+            for (size_t i = 0; i < len; ++i) put(buf[i]);
+        }
+
+        bool contains(const std::string &s) const {
+            for (auto &line: cells) {
+                if (line.find(s) != std::string::npos) return true;
+            }
+            return false;
+        }
+
+        char at(int y, int x) const { return cells[y][x]; }
+
+        // cells painted with a background color in the box [0, h) x [0, w), counted per column
+        std::vector<int> columnPaint(int h, int w) const {
+            std::vector<int> count(w, 0);
+            for (int i = 0; i < h && i < rows; ++i) {
+                for (int j = 0; j < w && j < cols; ++j) count[j] += paint[i][j] == '#';
+            }
+            return count;
+        }
+
+    private:
+        enum State { TEXT, ESC, CSI, CHARSET };
+
+        void put(char c) {
+            switch (state) {
+                case TEXT:
+                    text(c);
+                    break;
+                case ESC:
+                    escape(c);
+                    break;
+                case CSI:
+                    if ((c >= '0' && c <= '9') || c == ';' || c == '?' || c == '>' || c == '!') {
+                        params += c;
+                    } else {
+                        csi(c);
+                        state = TEXT;
+                    }
+                    break;
+                case CHARSET:
+                    state = TEXT;
+                    break;
+            }
+        }
+
+        void text(char c) {
+            switch (c) {
+                case '\033':
+                    state = ESC;
+                    break;
+                case '\r':
+                    x = 0;
+                    break;
+                case '\n':
+                    lineFeed();
+                    break;
+                case '\b':
+                    if (x > 0) --x;
+                    break;
+                default:
+                    if ((unsigned char) c < ' ') break;
+                    if (x >= cols) {
+                        x = 0;
+                        lineFeed();
+                    }
+                    last = c;
+                    paint[y][x] = background;
+                    cells[y][x++] = c;
+            }
+        }
+
+        void escape(char c) {
+            state = TEXT;
+            switch (c) {
+                case '[':
+                    params.clear();
+                    state = CSI;
+                    break;
+                case '(':
+                case ')':
+                    state = CHARSET;
+                    break;
+                case '7':
+                    savedY = y;
+                    savedX = x;
+                    break;
+                case '8':
+                    y = savedY;
+                    x = savedX;
+                    break;
+                case 'D':
+                    lineFeed();
+                    break;
+                case 'E':
+                    x = 0;
+                    lineFeed();
+                    break;
+                case 'M':
+                    if (y == top) scroll(top, bottom, -1);
+                    else if (y > 0) --y;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        int param(size_t i, int def) const {
+            std::vector<int> v;
+            const char *p = params.c_str();
+            while (*p == '?' || *p == '>' || *p == '!') ++p;
+            while (*p) {
+                v.push_back(atoi(p));
+                while (*p && *p != ';') ++p;
+                if (*p) ++p;
+            }
+            return i < v.size() && v[i] ? v[i] : def;
+        }
+
+        void csi(char c) {
+            switch (c) {
+                case 'H':
+                case 'f':
+                    y = clampY(param(0, 1) - 1);
+                    x = clampX(param(1, 1) - 1);
+                    break;
+                case 'd':
+                    y = clampY(param(0, 1) - 1);
+                    break;
+                case 'G':
+                case '`':
+                    x = clampX(param(0, 1) - 1);
+                    break;
+                case 'A':
+                    y = clampY(y - param(0, 1));
+                    break;
+                case 'B':
+                    y = clampY(y + param(0, 1));
+                    break;
+                case 'C':
+                    x = clampX(x + param(0, 1));
+                    break;
+                case 'D':
+                    x = clampX(x - param(0, 1));
+                    break;
+                case 'K': {
+                    int mode = param(0, 0);
+                    int from = mode == 0 ? x : 0;
+                    int to = mode == 1 ? x + 1 : cols;
+                    clear(y, from, to);
+                    break;
+                }
+                case 'J': {
+                    int mode = param(0, 0);
+                    if (mode == 0) {
+                        clear(y, x, cols);
+                        for (int i = y + 1; i < rows; ++i) clear(i, 0, cols);
+                    } else if (mode == 1) {
+                        for (int i = 0; i < y; ++i) clear(i, 0, cols);
+                        clear(y, 0, x + 1);
+                    } else {
+                        for (int i = 0; i < rows; ++i) clear(i, 0, cols);
+                    }
+                    break;
+                }
+                case 'X':
+                    clear(y, x, x + param(0, 1));
+                    break;
+                case 'b': // repeat the last character
+                    for (int i = param(0, 1); i > 0; --i) text(last);
+                    break;
+                case 'm':
+                    sgr();
+                    break;
+                case 'P': {
+                    int n = std::min(param(0, 1), cols - x);
+                    cells[y].erase(x, n);
+                    cells[y].append(n, ' ');
+                    paint[y].erase(x, n);
+                    paint[y].append(n, background);
+                    break;
+                }
+                case '@': {
+                    int n = std::min(param(0, 1), cols - x);
+                    cells[y].insert(x, n, ' ');
+                    cells[y].resize(cols);
+                    paint[y].insert(x, n, background);
+                    paint[y].resize(cols);
+                    break;
+                }
+                case 'L':
+                    if (y >= top && y <= bottom) scroll(y, bottom, -param(0, 1));
+                    break;
+                case 'M':
+                    if (y >= top && y <= bottom) scroll(y, bottom, param(0, 1));
+                    break;
+                case 'S':
+                    scroll(top, bottom, param(0, 1));
+                    break;
+                case 'T':
+                    scroll(top, bottom, -param(0, 1));
+                    break;
+                case 'r':
+                    if (params.empty() || params[0] != '?') {
+                        top = clampY(param(0, 1) - 1);
+                        bottom = clampY(param(1, rows) - 1);
+                        y = 0;
+                        x = 0;
+                    }
+                    break;
+                default: // h, l, t and the like do not move text
+                    break;
+            }
+        }
+
+        // only the background matters: the game paints cells as colored spaces
+        void sgr() {
+            std::vector<int> v;
+            const char *p = params.c_str();
+            while (*p) {
+                v.push_back(atoi(p));
+                while (*p && *p != ';') ++p;
+                if (*p) ++p;
+            }
+            if (v.empty()) v.push_back(0);
+            for (int a: v) {
+                // black is the default background here, pieces are never black
+                if (a == 0 || a == 40 || a == 49 || a == 100) background = ' ';
+                else if ((a > 40 && a <= 47) || (a > 100 && a <= 107)) background = '#';
+            }
+        }
+
+        // erasing fills with the current background, as xterm does
+        void clear(int row, int from, int to) {
+            for (int i = std::max(0, from); i < to && i < cols; ++i) {
+                cells[row][i] = ' ';
+                paint[row][i] = background;
+            }
+        }
+
+        void lineFeed() {
+            if (y == bottom) scroll(top, bottom, 1);
+            else if (y < rows - 1) ++y;
+        }
+
+        // positive n moves lines up
+        void scroll(int from, int to, int n) {
+            for (int k = 0; k < std::abs(n); ++k) {
+                for (auto *v: {&cells, &paint}) {
+                    if (n > 0) {
+                        v->erase(v->begin() + from);
+                        v->insert(v->begin() + to, std::string(cols, ' '));
+                    } else {
+                        v->erase(v->begin() + to);
+                        v->insert(v->begin() + from, std::string(cols, ' '));
+                    }
+                }
+            }
+        }
+
+        int clampY(int v) const { return std::max(0, std::min(rows - 1, v)); }
+        int clampX(int v) const { return std::max(0, std::min(cols - 1, v)); }
+
+    private:
+        int rows;
+        int cols;
+        std::vector<std::string> cells;
+        std::vector<std::string> paint; // '#' where the background is colored
+        char background = ' ';
+        char last = ' ';
+        int y = 0;
+        int x = 0;
+        int savedY = 0;
+        int savedX = 0;
+        int top = 0;
+        int bottom;
+        State state = TEXT;
+        std::string params;
+    };
+
+    // ================================================== class Session
+    class Session {
+    public:
+        explicit Session(const char *path) {
+            struct winsize ws{};
+            ws.ws_row = ROWS;
+            ws.ws_col = COLS;
+            pid = forkpty(&fd, nullptr, nullptr, &ws);
+            if (pid == 0) {
+                setenv("TERM", "xterm", 0);
+                execl(path, path, (char *) nullptr);
+                _exit(127);
+            }
+        }
+
+        ~Session() {
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+            if (fd >= 0) close(fd);
+        }
+
+        bool ok() const { return pid > 0 && fd >= 0; }
+
+        void send(char c) const {
+            if (write(fd, &c, 1) != 1) perror("write");
+        }
+
+        // read one chunk into the screen if it arrives before deadline (microseconds): 1 read, 0 none, -1 EOF
+        int readUntil(long long deadline) {
+            long long left = deadline - nowUs();
+            struct pollfd p{fd, POLLIN, 0};
+            if (poll(&p, 1, left <= 0 ? 0 : (int) ((left + 999) / 1000)) <= 0) return 0;
+            char buf[8192];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) return -1;
+            long long t = nowUs();
+            if (t - lastOutput > BURST_GAP_US) ++bursts;
+            lastOutput = t;
+            bytes += n;
+            screen.feed(buf, n);
+            return 1;
+        }
+
+        // read what arrives until deadline or until done() holds, return false on EOF
+        template<typename F>
+        bool pump(long long deadline, F done) {
+            while (!done() && nowUs() < deadline) {
+                if (readUntil(deadline) < 0) return false;
+            }
+            return true;
+        }
+
+    public:
+        Screen screen{ROWS, COLS};
+        unsigned long long bytes = 0;
+        unsigned long long bursts = 0;
+        long long lastOutput = 0; // when the last chunk was read
+
+    private:
+        pid_t pid = -1;
+        int fd = -1;
+    };
+
+    struct Key {
+        long long at; // microseconds after the game start
+        char key;
+    };
+
+    struct Sent {
+        long long at; // when it was written
+        int dir; // -1 left, 1 right
+    };
+
+    // "<ms> <key>" lines, sorted by time
+    bool readScript(const char *path, std::vector<Key> &keys) {
+        FILE *f = fopen(path, "r");
+        if (!f) return false;
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            char *hash = strchr(line, '#');
+            if (hash) *hash = 0;
+            long long ms;
+            char key;
+            if (sscanf(line, "%lld %c", &ms, &key) == 2) keys.push_back(Key{ms * 1000, key});
+        }
+        fclose(f);
+        std::stable_sort(keys.begin(), keys.end(), [](const Key &a, const Key &b) { return a.at < b.at; });
+        return true;
+    }
+
+    // cells moved to the right (positive) or left by the change from before to now, 0 if it is not a move
+    int moveOf(const std::vector<int> &before, const std::vector<int> &now) {
+        if (now == before || std::accumulate(now.begin(), now.end(), 0) !=
+                             std::accumulate(before.begin(), before.end(), 0)) {
+            return 0;
+        }
+        // a whole piece is 8 painted characters, one cell is two columns
+        long long moment = 0;
+        for (size_t j = 0; j < now.size(); ++j) moment += (long long) j * (now[j] - before[j]);
+        int cells = (int) ((std::abs(moment) + 8) / 16);
+        return (moment > 0 ? 1 : -1) * std::max(cells, 1);
+    }
+
+    double percentile(std::vector<long long> v, double p) {
+        if (v.empty()) return 0;
+        std::sort(v.begin(), v.end());
+        size_t i = std::min(v.size() - 1, (size_t) (p / 100.0 * (double) v.size()));
+        return (double) v[i] / 1000.0;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *usage = "usage: %s <tetris binary> [-s script] [-n keys] [-i interval ms] [-l p99 limit ms]\n";
+    if (argc < 2) {
+        fprintf(stderr, usage, argv[0]);
+        return 2;
+    }
+    const char *script = nullptr;
+    int keyNum = 200;
+    long long intervalUs = 50000;
+    double limitMs = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (i + 1 < argc && !strcmp(argv[i], "-s")) script = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "-n")) keyNum = atoi(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "-i")) intervalUs = atoi(argv[++i]) * 1000LL;
+        else if (i + 1 < argc && !strcmp(argv[i], "-l")) limitMs = atof(argv[++i]);
+        else {
+            fprintf(stderr, usage, argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Key> keys;
+    if (script) {
+        if (!readScript(script, keys)) {
+            perror(script);
+            return 1;
+        }
+    } else {
+        for (int i = 0; i < keyNum; ++i) keys.push_back(Key{i * intervalUs, i % 2 ? 'd' : 'a'});
+    }
+
+    Session s(argv[1]);
+    if (!s.ok()) {
+        perror("forkpty");
+        return 1;
+    }
+
+    // wait for the start prompt, then start the game
+    if (!s.pump(nowUs() + 3000000, [&] { return s.screen.contains("Press any key to start"); }) ||
+        !s.screen.contains("Press any key to start")) {
+        fprintf(stderr, "tetris did not start, is the terminal large enough?\n");
+        return 1;
+    }
+    s.send('x');
+    s.pump(nowUs() + 300000, [&] { return s.screen.contains("[Game Start]"); });
+
+    // the game field is the box in the top left corner, inside its border
+    int fieldW = 1;
+    while (fieldW < COLS && s.screen.at(0, fieldW) != 'k') ++fieldW;
+    int fieldH = 1;
+    while (fieldH < ROWS && s.screen.at(fieldH, 0) != 'm') ++fieldH;
+    if (fieldW == COLS || fieldH == ROWS) {
+        fprintf(stderr, "game field not found\n");
+        return 1;
+    }
+
+    std::vector<long long> latency;
+    std::deque<Sent> waiting; // timed keys not matched yet, oldest first
+    int timed = 0;
+    int lost = 0;
+    long long maxLateUs = 0; // how far sending fell behind the schedule
+    std::vector<int> shown = s.screen.columnPaint(fieldH, fieldW);
+    bool inFrame = false;
+    unsigned long long bytes0 = s.bytes;
+    unsigned long long bursts0 = s.bursts;
+    long long start = nowUs();
+    long long end = start + (keys.empty() ? 0 : keys.back().at) + DRAIN_US;
+    size_t next = 0;
+    bool alive = true;
+
+    // a frame is over once the output pauses, its last byte is when it was shown
+    auto endFrame = [&] {
+        std::vector<int> now = s.screen.columnPaint(fieldH, fieldW);
+        int move = moveOf(shown, now);
+        shown = now;
+        for (int dir = move > 0 ? 1 : -1; move; move -= dir) {
+            auto it = std::find_if(waiting.rbegin(), waiting.rend(), [dir](const Sent &k) { return k.dir == dir; });
+            if (it == waiting.rend()) break; // a move nobody asked for, e.g. auto play
+            latency.push_back(s.lastOutput - it->at);
+            size_t matched = waiting.size() - (it - waiting.rbegin()); // it and the keys before it
+            lost += (int) matched - 1;
+            waiting.erase(waiting.begin(), waiting.begin() + (long) matched);
+        }
+    };
+
+    while (alive) {
+        long long now = nowUs();
+        while (next < keys.size() && start + keys[next].at <= now) {
+            char key = keys[next].key;
+            s.send(key);
+            long long sent = nowUs();
+            maxLateUs = std::max(maxLateUs, sent - (start + keys[next].at));
+            if (key == 'a' || key == 'd') {
+                waiting.push_back(Sent{sent, key == 'a' ? -1 : 1});
+                ++timed;
+            }
+            ++next;
+        }
+        while (!waiting.empty() && now - waiting.front().at > KEY_TIMEOUT_US) {
+            waiting.pop_front();
+            ++lost;
+        }
+        if (next == keys.size() && (now >= end || s.screen.contains("[Game Over]"))) break;
+
+        long long wake = next < keys.size() ? start + keys[next].at : end;
+        if (inFrame) wake = std::min(wake, s.lastOutput + BURST_GAP_US);
+        int got = s.readUntil(wake);
+        if (got < 0) alive = false;
+        if (got > 0) {
+            inFrame = true;
+        } else if (inFrame && nowUs() >= s.lastOutput + BURST_GAP_US) {
+            endFrame();
+            inFrame = false;
+        }
+    }
+    if (inFrame) endFrame();
+    lost += (int) waiting.size();
+    double seconds = (double) (nowUs() - start) / 1e6;
+
+    s.send('q');
+    s.pump(nowUs() + 200000, [] { return false; });
+    s.send('q');
+
+    double p99 = percentile(latency, 99);
+    printf("keys        %zu sent, %d timed, late by at most %.2f ms\n", next, timed, (double) maxLateUs / 1000.0);
+    printf("moves       %zu shown, %d not seen\n", latency.size(), lost);
+    printf("latency ms  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           percentile(latency, 50), percentile(latency, 90), p99, percentile(latency, 100));
+    printf("frames/s    %.1f\n", (double) (s.bursts - bursts0) / seconds);
+    printf("bytes/s     %.0f\n", (double) (s.bytes - bytes0) / seconds);
+
+    if (limitMs > 0) {
+        bool pass = alive && p99 <= limitMs && latency.size() * 2 >= (size_t) timed;
+        printf("%s: p99 limit %.2f ms, at least half of the timed keys seen\n", pass ? "PASS" : "FAIL", limitMs);
+        return pass ? 0 : 1;
+    }
+    return 0;
+}
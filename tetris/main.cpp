@@ -1,8 +1,44 @@
 #include "tetris.h"
+#include "spectator.h"
+#include <cstdlib>
+#include <cstring>
 
-int main() {
-    tetris::Tetris game;
-    game.initDisplay();
+int main(int argc, char **argv) {
+    // tetris [-b opening book] [checkpoint file]
+    // the checkpoint is resumed from if present and saved on every landing
+    // tetris -w [games]: watch bots play as many games as fit on the terminal
+    // -m socket: serve metrics in Prometheus text format on a Unix domain socket
+    // -d file: record every landed piece as a training sample, see dataset.h
+    const char *book = nullptr;
+    const char *checkpoint = nullptr;
+    const char *metrics = nullptr;
+    const char *dataset = nullptr;
+    int watch = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+            book = argv[++i];
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            metrics = argv[++i];
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            dataset = argv[++i];
+        } else if (!strcmp(argv[i], "-w")) {
+            watch = i + 1 < argc ? atoi(argv[++i]) : 0;
+            if (watch <= 0) watch = 1 << 16;
+        } else {
+            checkpoint = argv[i];
+        }
+    }
+
+    if (watch) {
+        tetris::Spectator spectator(watch, metrics, dataset);
+        if (!spectator.initDisplay()) return 1;
+        spectator.enter();
+        spectator.destroyDisplay();
+        return 0;
+    }
+
+    tetris::Tetris game(checkpoint, book, metrics, dataset);
+    if (!game.initDisplay()) return 1;
     game.enter();
     game.destroyDisplay();
     return 0;
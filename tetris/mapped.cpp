@@ -0,0 +1,85 @@
+#include "mapped.h"
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace tetris;
+
+// ================================================== class MappedFile
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char *path) {
+    close();
+#ifdef _WIN32
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (n > 0) {
+        ptr = malloc(n);
+        len = n;
+        if (fread(ptr, 1, len, fp) != len) close();
+    }
+    fclose(fp);
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ptr = p;
+            len = st.st_size;
+        }
+    }
+    ::close(fd);
+#endif
+    return ptr != nullptr;
+}
+
+void MappedFile::close() {
+    if (!ptr) return;
+#ifdef _WIN32
+    free(ptr);
+#else
+    munmap(ptr, len);
+#endif
+    ptr = nullptr;
+    len = 0;
+}
+
+const void *MappedFile::data() const {
+    return ptr;
+}
+
+size_t MappedFile::size() const {
+    return len;
+}
+
+bool MappedFile::writeAtomic(const char *path, const void *head, size_t headLen, const void *body, size_t bodyLen) {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp) return false;
+
+    bool ok = fwrite(head, 1, headLen, fp) == headLen && (!bodyLen || fwrite(body, 1, bodyLen, fp) == bodyLen);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) {
+        remove(tmp.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(tmp.c_str(), path) == 0;
+}
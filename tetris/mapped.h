@@ -0,0 +1,31 @@
+#ifndef TETRIS_MAPPED_H
+#define TETRIS_MAPPED_H
+
+#include <cstddef>
+
+namespace tetris {
+    // ================================================== class MappedFile
+    // Read-only memory mapping of a whole file, read into memory where mmap is not available.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+
+        bool open(const char *path);
+        void close();
+        const void *data() const;
+        size_t size() const;
+
+        // write head then body to a temporary file and rename it over path,
+        // so a crash never leaves a torn file behind
+        static bool writeAtomic(const char *path, const void *head, size_t headLen, const void *body, size_t bodyLen);
+
+    private:
+        void *ptr = nullptr;
+        size_t len = 0;
+    };
+}
+
+#endif //TETRIS_MAPPED_H
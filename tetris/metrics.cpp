@@ -0,0 +1,244 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace tetris;
+
+// ================================================== local functions
+static void appendf(std::string &out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string &out, const char *fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > 0) out.append(buf, std::min((size_t) n, sizeof(buf) - 1));
+}
+
+// ================================================== class Metrics
+const int Metrics::MAX_LINES;
+const int Metrics::LATENCY_BUCKETS;
+const uint64_t Metrics::LATENCY_BOUNDS[LATENCY_BUCKETS] = {
+        100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+        1000000, 2000000, 5000000, 10000000, 20000000, 50000000, 100000000, 200000000, 500000000
+};
+
+void Metrics::tickRun(uint64_t latencyNs) {
+    int b = 0;
+    while (b < LATENCY_BUCKETS && latencyNs > LATENCY_BOUNDS[b]) ++b;
+    latency[b].fetch_add(1, std::memory_order_relaxed);
+    latencySum.fetch_add(latencyNs, std::memory_order_relaxed);
+    ticks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::tickSkipped(uint64_t n) {
+    skipped.fetch_add(n, std::memory_order_relaxed);
+}
+
+void Metrics::piecePlaced(int lines, unsigned int gain) {
+    pieces.fetch_add(1, std::memory_order_relaxed);
+    if (lines > 0 && lines <= MAX_LINES) clears[lines].fetch_add(1, std::memory_order_relaxed);
+    score.fetch_add(gain, std::memory_order_relaxed);
+}
+
+void Metrics::gameOver() {
+    games.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the bucket holding the q-th sample, interpolated linearly inside it
+double Metrics::quantile(const uint64_t *counts, uint64_t total, double q) const {
+    if (!total) return 0;
+    double rank = q * (double) total;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        if (counts[b] && (double) (seen + counts[b]) >= rank) {
+            double lo = b ? (double) LATENCY_BOUNDS[b - 1] : 0;
+            double hi = (double) LATENCY_BOUNDS[b];
+            return lo + (hi - lo) * (rank - (double) seen) / (double) counts[b];
+        }
+        seen += counts[b];
+    }
+    return (double) LATENCY_BOUNDS[LATENCY_BUCKETS - 1];
+}
+
+std::string Metrics::render() const {
+    uint64_t counts[LATENCY_BUCKETS + 1];
+    uint64_t total = 0;
+    for (int b = 0; b <= LATENCY_BUCKETS; ++b) {
+        counts[b] = latency[b].load(std::memory_order_relaxed);
+        total += counts[b];
+    }
+
+    std::string out;
+    out.reserve(2048);
+    appendf(out, "# HELP tetris_ticks_total Game ticks run.\n# TYPE tetris_ticks_total counter\n");
+    appendf(out, "tetris_ticks_total %llu\n", (unsigned long long) ticks.load(std::memory_order_relaxed));
+    appendf(out, "# HELP tetris_ticks_skipped_total Game ticks dropped because the previous one was still running.\n");
+    appendf(out, "# TYPE tetris_ticks_skipped_total counter\n");
+    appendf(out, "tetris_ticks_skipped_total %llu\n", (unsigned long long) skipped.load(std::memory_order_relaxed));
+    appendf(out, "# HELP tetris_pieces_total Pieces landed.\n# TYPE tetris_pieces_total counter\n");
+    appendf(out, "tetris_pieces_total %llu\n", (unsigned long long) pieces.load(std::memory_order_relaxed));
+    appendf(out, "# HELP tetris_line_clears_total Landings that cleared the given number of lines at once.\n");
+    appendf(out, "# TYPE tetris_line_clears_total counter\n");
+    for (int n = 1; n <= MAX_LINES; ++n) {
+        appendf(out, "tetris_line_clears_total{lines=\"%d\"} %llu\n", n,
+                (unsigned long long) clears[n].load(std::memory_order_relaxed));
+    }
+    appendf(out, "# HELP tetris_score_total Points scored.\n# TYPE tetris_score_total counter\n");
+    appendf(out, "tetris_score_total %llu\n", (unsigned long long) score.load(std::memory_order_relaxed));
+    appendf(out, "# HELP tetris_games_over_total Games lost.\n# TYPE tetris_games_over_total counter\n");
+    appendf(out, "tetris_games_over_total %llu\n", (unsigned long long) games.load(std::memory_order_relaxed));
+
+    // quantiles are estimated from the buckets, so they are as coarse as the buckets
+    appendf(out, "# HELP tetris_tick_latency_seconds Time spent in one game tick.\n");
+    appendf(out, "# TYPE tetris_tick_latency_seconds summary\n");
+    for (double q: {0.5, 0.9, 0.99, 0.999}) {
+        appendf(out, "tetris_tick_latency_seconds{quantile=\"%g\"} %.9g\n", q, quantile(counts, total, q) * 1e-9);
+    }
+    appendf(out, "tetris_tick_latency_seconds_sum %.9g\n",
+            (double) latencySum.load(std::memory_order_relaxed) * 1e-9);
+    appendf(out, "tetris_tick_latency_seconds_count %llu\n", (unsigned long long) total);
+    return out;
+}
+
+// ================================================== class MetricsServer
+const int MetricsServer::POLL_MS;
+const int MetricsServer::MAX_CLIENTS;
+const int MetricsServer::CLIENT_TIMEOUT_MS;
+const size_t MetricsServer::MAX_REQUEST;
+
+MetricsServer::MetricsServer(const Metrics &metrics) : metrics(metrics) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+#ifdef _WIN32
+bool MetricsServer::start(const char *) {
+    return false;
+}
+
+void MetricsServer::stop() {}
+
+void MetricsServer::serveThread() {}
+#else
+bool MetricsServer::start(const char *p) {
+    stop();
+    sockaddr_un addr{};
+    if (strlen(p) >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, p);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    unlink(p);
+    if (bind(fd, (sockaddr *) &addr, sizeof(addr)) || listen(fd, MAX_CLIENTS)) {
+        ::close(fd);
+        return false;
+    }
+    listenFd = fd;
+    path = p;
+    running = true;
+    server = std::thread(&MetricsServer::serveThread, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!running) return;
+    running = false;
+    server.join();
+    ::close(listenFd);
+    listenFd = -1;
+    unlink(path.c_str());
+}
+
+void MetricsServer::serveThread() {
+    struct Client {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t sent;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+
+    while (running) {
+        fds.assign(1, pollfd{listenFd, POLLIN, 0});
+        for (auto &c: clients) {
+            fds.push_back(pollfd{c.fd, (short) (c.out.empty() ? POLLIN : POLLOUT), 0});
+        }
+        if (poll(fds.data(), fds.size(), POLL_MS) < 0) continue;
+
+        // clients that stall are dropped, so they can not keep every slot
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client &c = clients[i];
+            short ev = fds[i + 1].revents;
+            bool done = (ev & (POLLERR | POLLNVAL)) != 0 || now >= c.deadline;
+            if (!done && c.out.empty() && (ev & (POLLIN | POLLHUP))) {
+                char buf[1024];
+                ssize_t n = read(c.fd, buf, sizeof(buf));
+                if (n > 0) c.in.append(buf, n);
+                // answer after the request headers or a plain line, or when the client stops sending.
+                // Closing with unread input would reset the connection before the client reads the answer.
+                bool http = c.in.compare(0, 4, "GET ") == 0;
+                bool complete = http ? c.in.find("\r\n\r\n") != std::string::npos || c.in.find("\n\n") != std::string::npos
+                                     : c.in.find('\n') != std::string::npos;
+                if (n == 0 || complete || c.in.size() >= MAX_REQUEST) {
+                    std::string body = metrics.render();
+                    if (http) {
+                        char head[128];
+                        snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+                        c.out = head + body;
+                    } else {
+                        c.out.swap(body);
+                    }
+                    c.sent = 0;
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    done = true;
+                }
+            } else if (!done && !c.out.empty() && (ev & (POLLOUT | POLLHUP))) {
+                ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+                if (n > 0) c.sent += n;
+                if (c.sent == c.out.size() || (n < 0 && errno != EAGAIN && errno != EINTR)) done = true;
+            }
+            if (done) {
+                ::close(c.fd);
+                clients[i] = std::move(clients.back());
+                clients.pop_back();
+                fds[i + 1] = fds[clients.size() + 1];
+                --i;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                if ((int) clients.size() >= MAX_CLIENTS) {
+                    ::close(fd);
+                    continue;
+                }
+                clients.push_back(Client{fd, std::string(), std::string(), 0,
+                                         now + std::chrono::milliseconds(CLIENT_TIMEOUT_MS)});
+            }
+        }
+    }
+    for (auto &c: clients) ::close(c.fd);
+}
+#endif
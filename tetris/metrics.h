@@ -0,0 +1,76 @@
+#ifndef TETRIS_METRICS_H
+#define TETRIS_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace tetris {
+    // ================================================== class Metrics
+    // Lock-free counters of a running game, updated by the game threads and read by MetricsServer.
+    class Metrics {
+    public:
+        const static int MAX_LINES = 4; // at most 4 lines clear at once
+        const static int LATENCY_BUCKETS = 21;
+        const static uint64_t LATENCY_BOUNDS[LATENCY_BUCKETS]; // upper bounds in nanoseconds
+
+        Metrics() = default;
+        Metrics(const Metrics &) = delete;
+        Metrics &operator=(const Metrics &) = delete;
+
+        void tickRun(uint64_t latencyNs);
+        void tickSkipped(uint64_t n = 1);
+        // one landed piece clearing `lines` rows and scoring `gain`
+        void piecePlaced(int lines, unsigned int gain);
+        void gameOver();
+
+        // Prometheus text exposition format
+        std::string render() const;
+
+    private:
+        double quantile(const uint64_t *counts, uint64_t total, double q) const;
+
+    private:
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<uint64_t> pieces{0};
+        std::atomic<uint64_t> clears[MAX_LINES + 1] = {}; // clears[n]: pieces that cleared n lines
+        std::atomic<uint64_t> score{0};
+        std::atomic<uint64_t> games{0};
+        std::atomic<uint64_t> latency[LATENCY_BUCKETS + 1] = {}; // the last one is +Inf
+        std::atomic<uint64_t> latencySum{0};
+    };
+
+    // ================================================== class MetricsServer
+    // Serves Metrics::render() on a Unix domain socket, to plain HTTP GETs or to any line sent by the client.
+    // One thread polls all sockets without blocking and touches nothing but the atomics in Metrics.
+    class MetricsServer {
+    public:
+        explicit MetricsServer(const Metrics &metrics);
+        MetricsServer(const MetricsServer &) = delete;
+        MetricsServer &operator=(const MetricsServer &) = delete;
+        ~MetricsServer();
+
+        // false if the socket can not be created, an old socket file at path is replaced
+        bool start(const char *path);
+        void stop();
+
+    private:
+        void serveThread();
+
+    private:
+        const static int POLL_MS = 200;
+        const static int MAX_CLIENTS = 16;
+        const static int CLIENT_TIMEOUT_MS = 2000; // to send a request and read the answer, then the slot is freed
+        const static size_t MAX_REQUEST = 4096;
+
+        const Metrics &metrics;
+        std::string path;
+        int listenFd = -1;
+        std::thread server;
+        std::atomic<bool> running{false};
+    };
+}
+
+#endif //TETRIS_METRICS_H
@@ -0,0 +1,45 @@
+#ifndef TETRIS_RANDOM_H
+#define TETRIS_RANDOM_H
+
+#include <cstdint>
+
+namespace tetris {
+    // ================================================== class Random
+    // xorshift64* generator. The whole state is one word, so it can be saved and restored.
+    class Random {
+    public:
+        typedef uint64_t state_t;
+
+        Random() = default;
+        explicit Random(state_t seed) { reseed(seed); }
+
+        void reseed(state_t seed) {
+            // splitmix64 scramble, state must never be zero
+            seed += 0x9E3779B97F4A7C15ULL;
+            seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+            seed ^= seed >> 31;
+            state = seed ? seed : 1;
+        }
+
+        state_t getState() const { return state; }
+        void setState(state_t s) { state = s ? s : 1; }
+
+        uint64_t next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1DULL;
+        }
+
+        // uniform integer in [min, max]
+        int randint(int min, int max) {
+            return min + (int) ((next() >> 32) % (uint64_t) (max - min + 1));
+        }
+
+    private:
+        state_t state = 1;
+    };
+}
+
+#endif //TETRIS_RANDOM_H
@@ -0,0 +1,68 @@
+#include "rollback.h"
+
+using namespace engine;
+
+// ================================================== struct Snapshot
+const int Snapshot::MAX_SNAPSHOT_WIDTH;
+
+void Snapshot::save(const State &st, int act) {
+    // full fixed-size loop, the compiler turns it into a few vector packs
+    for (int y = 0; y < MAX_HEIGHT; ++y) rows[y] = (srow_t) st.board.rows[y];
+    tick = st.tick;
+    rng = st.rng.getState();
+    score = st.score;
+    lines = st.lines;
+    cur = st.cur;
+    nxt = st.nxt;
+    done = st.done;
+    action = (uint8_t) act;
+}
+
+void Snapshot::load(State &st) const {
+    for (int y = 0; y < MAX_HEIGHT; ++y) st.board.rows[y] = rows[y];
+    st.tick = tick;
+    st.rng.setState(rng);
+    st.score = score;
+    st.lines = lines;
+    st.cur = cur;
+    st.nxt = nxt;
+    st.done = done;
+}
+
+// ================================================== class Rollback
+const int Rollback::DEFAULT_CAPACITY;
+
+Rollback::Rollback(int capacity) : ring(capacity > 0 ? capacity : DEFAULT_CAPACITY) {}
+
+bool Rollback::reset(uint64_t seed, int height, int width) {
+    if (width > Snapshot::MAX_SNAPSHOT_WIDTH || !game.reset(seed, height, width)) return false;
+    first = 0;
+    return true;
+}
+
+unsigned int Rollback::step(int action) {
+    const State &st = game.state();
+    // a finished game does not advance, nothing to record
+    if (st.done) return 0;
+    slot(st.tick).save(st, action);
+    if (st.tick - first >= ring.size()) first = st.tick - ring.size() + 1;
+    return game.step(action);
+}
+
+bool Rollback::rewind(uint64_t tick) {
+    if (tick < oldest() || tick >= now()) return false;
+    slot(tick).load(game.state());
+    return true;
+}
+
+bool Rollback::correct(uint64_t tick, int action) {
+    uint64_t end = now();
+    if (tick < oldest() || tick >= end) return false;
+    slot(tick).action = (uint8_t) action;
+    slot(tick).load(game.state());
+    // replaying rewrites every slot up to end with the corrected states, inputs stay as recorded
+    for (uint64_t t = tick; t < end && !game.state().done; ++t) {
+        step(slot(t).action);
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef TETRIS_ROLLBACK_H
+#define TETRIS_ROLLBACK_H
+
+#include "engine.h"
+#include <vector>
+
+namespace engine {
+    // ================================================== struct Snapshot
+    // State at the start of a tick in 168 bytes, rows narrowed to 16 bits.
+    // Fixed size and no pointers, so taking and restoring one is a plain copy.
+    struct Snapshot {
+        typedef uint16_t srow_t;
+        const static int MAX_SNAPSHOT_WIDTH = 16;
+
+        srow_t rows[MAX_HEIGHT];
+        uint64_t tick;
+        uint64_t rng;
+        uint32_t score;
+        uint32_t lines;
+        Piece cur;
+        Piece nxt;
+        uint8_t done;
+        uint8_t action; // input of this tick, replayed after a correction
+
+        void save(const State &st, int act);
+        void load(State &st) const;
+    };
+
+    // ================================================== class Rollback
+    // A Game that remembers the last `capacity` ticks, for versus play where remote inputs arrive late.
+    // A late input rewinds to its tick and replays the recorded inputs after it.
+    class Rollback {
+    public:
+        const static int DEFAULT_CAPACITY = 64;
+
+        explicit Rollback(int capacity = DEFAULT_CAPACITY);
+
+        // width is limited to Snapshot::MAX_SNAPSHOT_WIDTH
+        bool reset(uint64_t seed, int height = DEFAULT_HEIGHT, int width = DEFAULT_WIDTH);
+        // record the state and the input, then run one tick like Game::step
+        unsigned int step(int action);
+
+        // ticks [oldest(), now()) can be rewound to
+        uint64_t oldest() const { return first; }
+        uint64_t now() const { return game.state().tick; }
+        // go back to the start of tick, the ticks after it are forgotten
+        bool rewind(uint64_t tick);
+        // change the input of a past tick and replay up to now, false if the tick already left the ring
+        bool correct(uint64_t tick, int action);
+
+        const State &state() const { return game.state(); }
+
+    private:
+        Snapshot &slot(uint64_t tick) { return ring[tick % ring.size()]; }
+
+    private:
+        Game game;
+        std::vector<Snapshot> ring;
+        uint64_t first = 0; // oldest tick whose slot is not overwritten yet
+    };
+}
+
+#endif //TETRIS_ROLLBACK_H
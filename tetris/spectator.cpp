@@ -0,0 +1,254 @@
+#include "spectator.h"
+#include "tetris.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace tetris;
+
+// ================================================== class Spectator
+const unsigned long long Spectator::FRAME_MS;
+const unsigned long long Spectator::TICK_MS;
+const int Spectator::SPEED;
+const int Spectator::BOARD_HEIGHT;
+const int Spectator::BOARD_WIDTH;
+
+Spectator::Spectator(int games, const char *metricsPath, const char *datasetPath)
+        : GameNum(games), MetricsPath(metricsPath), DatasetPath(datasetPath) {}
+
+bool Spectator::initDisplay() {
+    display::RET_CODE ret = display::initDisplay();
+    if (ret) {
+        display::d_wprintw(display::getGlobalWin(), "%s\n", display::RET_INFO[ret]);
+        pressAnyKey();
+        return false;
+    }
+    display::getMaxYX(GlobalMaxRow, GlobalMaxCol);
+
+    if (!initField()) {
+        display::destroyDisplay();
+        return false;
+    }
+    return true;
+}
+
+void Spectator::enter() {
+    using namespace std::chrono;
+    using namespace std::this_thread;
+
+    if (MetricsPath && !MetricsSrv.start(MetricsPath)) {
+        display::d_wmove(display::getGlobalWin(), GlobalMaxRow - 1, 0);
+        pressAnyKey(display::getGlobalWin(), "Can not serve metrics, press any key ...");
+    }
+    Collecting = DatasetPath && Dataset.open(DatasetPath, BOARD_HEIGHT, BOARD_WIDTH);
+    if (DatasetPath && !Collecting) {
+        display::d_wmove(display::getGlobalWin(), GlobalMaxRow - 1, 0);
+        pressAnyKey(display::getGlobalWin(), "Can not write dataset, press any key ...");
+    }
+    Slots.reset(new Slot[GameNum]);
+    DrawnVersion.assign(GameNum, ~(uint64_t) 0);
+    Running = true;
+    WorkerNum = std::max(1, std::min(GameNum, (int) std::thread::hardware_concurrency()));
+    for (int i = 0; i < WorkerNum; ++i) {
+        Workers.emplace_back(&Spectator::workerThread, this, i);
+    }
+
+    void *win = display::getGlobalWin();
+    display::nodelay(win, true);
+    auto next = steady_clock::now();
+    bool quit = false;
+    while (!quit) {
+        int ch;
+        while ((ch = display::d_wgetchar(win)) != display::GETCH_ERR) {
+            if (ch == 'q') quit = true;
+        }
+
+        drawFrame();
+        display::endFrame();
+
+        next += milliseconds(FRAME_MS);
+        sleep_until(next);
+    }
+    display::nodelay(win, false);
+
+    Running = false;
+    for (auto &t: Workers) t.join();
+    Workers.clear();
+    MetricsSrv.stop();
+    if (Collecting) {
+        Collecting = false;
+        bool ok = Dataset.close();
+        char msg[128];
+        snprintf(msg, sizeof(msg), ok ? "Samples %llu, dropped %llu, press any key ..."
+                                      : "Write dataset failed, %llu samples kept, %llu dropped, press any key ...",
+                 (unsigned long long) Dataset.written(), (unsigned long long) Dataset.dropped());
+        void *win = display::getGlobalWin();
+        display::d_wmove(win, GlobalMaxRow - 1, 0);
+        display::d_wprintw(win, "%-*s", GlobalMaxCol - 1, ""); // over the status line
+        display::d_wmove(win, GlobalMaxRow - 1, 0);
+        pressAnyKey(win, msg);
+    }
+}
+
+void Spectator::destroyDisplay() {
+    Tiles.reset();
+    display::destroyDisplay();
+}
+
+bool Spectator::initField() {
+    int tileHeight, tileWidth;
+    display::MiniField::getSize(BOARD_HEIGHT, BOARD_WIDTH, tileHeight, tileWidth);
+    // the last line is the status line
+    int perRow = GlobalMaxCol / tileWidth;
+    int rows = (GlobalMaxRow - 1) / tileHeight;
+    GameNum = std::min(GameNum, perRow * rows);
+    if (GameNum < 1) {
+        display::d_wprintw(display::getGlobalWin(), "Your terminal are smaller than %dx%d, please exit and resize.\n",
+                           tileHeight + 1, tileWidth);
+        pressAnyKey();
+        return false;
+    }
+
+    Tiles.reset(new display::MiniField[GameNum]);
+    for (int i = 0; i < GameNum; ++i) {
+        if (Tiles[i].startWin(i / perRow * tileHeight, i % perRow * tileWidth, tileHeight, tileWidth)) {
+            display::d_wprintw(display::getGlobalWin(), "Create board %d failed.\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+void Spectator::workerThread(int id) {
+    using namespace std::chrono;
+    using namespace std::this_thread;
+
+    // games id, id + workers, ... belong to this worker
+    std::vector<int> ids;
+    std::vector<Player> players;
+    Random seeder((uint64_t) duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count() + id);
+    for (int i = id; i < GameNum; i += WorkerNum) {
+        ids.push_back(i);
+        players.emplace_back();
+        players.back().game.reset(seeder.next(), BOARD_HEIGHT, BOARD_WIDTH);
+    }
+
+    auto next = steady_clock::now();
+    while (Running) {
+        for (size_t i = 0; i < players.size(); ++i) {
+            for (int s = 0; s < SPEED; ++s) play(players[i], seeder);
+            publish(ids[i], players[i]);
+        }
+        next += milliseconds(TICK_MS);
+        // too far behind: drop the missed ticks instead of running them in a burst
+        auto now = steady_clock::now();
+        if (now > next + milliseconds(TICK_MS)) {
+            auto missed = (uint64_t) ((now - next) / milliseconds(TICK_MS));
+            GameMetrics.tickSkipped(missed * players.size() * SPEED);
+            next += missed * milliseconds(TICK_MS);
+        }
+        sleep_until(next);
+    }
+}
+
+void Spectator::play(Player &p, Random &seeder) {
+    engine::State &st = p.game.state();
+    if (st.done) {
+        ++Finished;
+        GameMetrics.gameOver();
+        p.game.reset(seeder.next(), BOARD_HEIGHT, BOARD_WIDTH);
+        p.planned = false;
+    }
+
+    // greedy: the best resting place of the current piece alone, that is enough to watch
+    if (!p.planned) {
+        engine::Piece land[engine::MAX_LANDINGS];
+        int n = engine::landings(st.board, st.cur, land);
+        double best = 0;
+        p.target = engine::Placement{st.cur.rot, st.cur.x};
+        for (int i = 0; i < n; ++i) {
+            engine::Board b = st.board;
+            b.place(land[i]);
+            double v = engine::evaluate(b, b.clearLines(land[i]));
+            if (!i || v > best) {
+                best = v;
+                p.target = engine::Placement{land[i].rot, land[i].x};
+            }
+        }
+        p.planned = true;
+    }
+
+    int action = engine::ACT_DOWN;
+    if (st.cur.rot != p.target.rot) {
+        action = engine::ACT_ROTATE;
+    } else if (st.cur.x < p.target.x) {
+        action = engine::ACT_RIGHT;
+    } else if (st.cur.x > p.target.x) {
+        action = engine::ACT_LEFT;
+    }
+    tetris::Random::state_t drawn = st.rng.getState();
+    uint32_t lines = st.lines;
+    auto start = std::chrono::steady_clock::now();
+    // step(action) in two halves, to see where the piece is if it lands
+    p.game.act(action);
+    engine::Piece landed = st.cur;
+    int nxt = st.nxt.kind;
+    engine::Board before;
+    if (Collecting) before = st.board;
+    unsigned int gain = p.game.step(engine::ACT_NONE);
+    GameMetrics.tickRun(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    // only a spawn draws from the generator, so it moved if and only if the piece landed
+    if (st.rng.getState() != drawn) {
+        p.planned = false;
+        GameMetrics.piecePlaced((int) (st.lines - lines), gain);
+        if (Collecting) Dataset.append(before, landed, nxt, (int) (st.lines - lines), gain);
+    }
+}
+
+void Spectator::publish(int id, const Player &p) {
+    const engine::State &st = p.game.state();
+    engine::Board b = st.board;
+    b.place(st.cur);
+
+    Slot &slot = Slots[id];
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    bool same = slot.score == st.score;
+    for (int y = 0; same && y < b.height; ++y) same = slot.rows[y] == b.rows[y];
+    if (same) return;
+    std::copy(b.rows, b.rows + b.height, slot.rows);
+    slot.score = st.score;
+    ++slot.version;
+}
+
+void Spectator::drawFrame() {
+    engine::row_t rows[engine::MAX_HEIGHT];
+    char title[16];
+    Redrawn = 0;
+    for (int i = 0; i < GameNum; ++i) {
+        unsigned int score;
+        {
+            Slot &slot = Slots[i];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            if (slot.version == DrawnVersion[i]) continue;
+            DrawnVersion[i] = slot.version;
+            std::copy(slot.rows, slot.rows + BOARD_HEIGHT, rows);
+            score = slot.score;
+        }
+        snprintf(title, sizeof(title), "%u", score);
+        Tiles[i].draw(rows, BOARD_HEIGHT, BOARD_WIDTH, title);
+        ++Redrawn;
+    }
+
+    // the status line once a second, endFrame() sends everything in one update
+    void *win = display::getGlobalWin();
+    if (!(Frames++ % (1000 / FRAME_MS))) {
+        display::OutputStats st = display::getOutputStats();
+        char status[128];
+        snprintf(status, sizeof(status), "%d games, %u over, %llu boards/frame, %llu B/frame, q: quit",
+                 GameNum, Finished.load(), Redrawn, st.lastFrameBytes);
+        display::d_wmove(win, GlobalMaxRow - 1, 0);
+        display::d_wprintw(win, "%-*.*s", GlobalMaxCol - 1, GlobalMaxCol - 1, status);
+        display::d_wrefresh(win);
+    }
+}
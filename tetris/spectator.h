@@ -0,0 +1,76 @@
+#ifndef TETRIS_SPECTATOR_H
+#define TETRIS_SPECTATOR_H
+
+#include "bot.h"
+#include "dataset.h"
+#include "display.h"
+#include "engine.h"
+#include "metrics.h"
+#include "random.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris {
+    // ================================================== class Spectator
+    // Runs many headless games played by a greedy bot and tiles them on one terminal.
+    // Workers publish a snapshot after every step, the drawing thread picks them up at a fixed frame rate
+    // and only redraws boards whose snapshot changed since the last frame.
+    class Spectator {
+    public:
+        explicit Spectator(int games, const char *metricsPath = nullptr, const char *datasetPath = nullptr);
+        bool initDisplay();
+        void enter();
+        void destroyDisplay();
+
+    private:
+        struct Slot {
+            std::mutex mutex;
+            uint64_t version = 0; // bumped whenever rows or score change
+            engine::row_t rows[engine::MAX_HEIGHT] = {};
+            unsigned int score = 0;
+        };
+
+        struct Player {
+            engine::Game game;
+            engine::Placement target{};
+            bool planned = false;
+        };
+
+        bool initField();
+        void workerThread(int id);
+        void play(Player &p, Random &seeder);
+        void publish(int id, const Player &p);
+        void drawFrame();
+
+    private:
+        const static unsigned long long FRAME_MS = 50;
+        const static unsigned long long TICK_MS = 20; // same pace as Tetris, times SPEED
+        const static int SPEED = 4;
+        const static int BOARD_HEIGHT = engine::DEFAULT_HEIGHT;
+        const static int BOARD_WIDTH = engine::DEFAULT_WIDTH;
+
+        int GlobalMaxRow = 0;
+        int GlobalMaxCol = 0;
+        int GameNum = 0;
+        int WorkerNum = 1;
+        std::unique_ptr<display::MiniField[]> Tiles; // fields own windows, never copied
+        std::vector<uint64_t> DrawnVersion;
+        std::unique_ptr<Slot[]> Slots;
+        std::vector<std::thread> Workers;
+        std::atomic<bool> Running{false};
+        std::atomic<unsigned int> Finished{0}; // games over so far
+        const char *MetricsPath = nullptr;
+        Metrics GameMetrics; // all games together
+        MetricsServer MetricsSrv{GameMetrics};
+        const char *DatasetPath = nullptr;
+        DatasetWriter Dataset; // shared by all workers
+        bool Collecting = false; // Dataset is open, set before the workers start
+        unsigned long long Frames = 0;
+        unsigned long long Redrawn = 0; // tiles redrawn in the last frame
+    };
+}
+
+#endif //TETRIS_SPECTATOR_H
@@ -0,0 +1,89 @@
+#include "taskpool.h"
+#include <algorithm>
+
+using namespace tetris;
+
+// ================================================== class TaskPool
+TaskPool::TaskPool(int threads) {
+    if (threads <= 0) threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(new Worker);
+    }
+    for (int i = 0; i < threads; ++i) {
+        this->threads.emplace_back(&TaskPool::workerThread, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    sleepCond.notify_all();
+    for (auto &t: threads) t.join();
+}
+
+int TaskPool::size() const {
+    return (int) workers.size();
+}
+
+void TaskPool::submit(task_t task) {
+    Worker &w = *workers[nextWorker++ % workers.size()];
+    ++pending;
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++queued;
+    }
+    sleepCond.notify_one();
+}
+
+void TaskPool::wait() {
+    while (pending) {
+        if (runOne(0)) continue;
+        // nothing left to take, the rest is running elsewhere
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        doneCond.wait(lock, [this] { return !pending || queued > 0; });
+    }
+}
+
+void TaskPool::workerThread(int id) {
+    while (running) {
+        if (runOne(id)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCond.wait(lock, [this] { return !running || queued > 0; });
+    }
+}
+
+bool TaskPool::runOne(int id) {
+    task_t task;
+    {
+        // own tasks from the back, the most recently queued is warm in cache
+        Worker &own = *workers[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < workers.size(); ++i) {
+        Worker &victim = *workers[(id + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+
+    --queued;
+    task();
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        doneCond.notify_all();
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef TETRIS_TASKPOOL_H
+#define TETRIS_TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris {
+    // ================================================== class TaskPool
+    // Work-stealing pool: every worker owns a deque, pops its own tasks from the back
+    // and steals from the front of the others when it runs dry. wait() helps as well.
+    // Nobody spins: idle workers and a waiter with nothing left to take sleep on condition variables.
+    class TaskPool {
+    public:
+        typedef std::function<void()> task_t;
+
+        explicit TaskPool(int threads = 0); // 0: one per core
+        TaskPool(const TaskPool &) = delete;
+        TaskPool &operator=(const TaskPool &) = delete;
+        ~TaskPool();
+
+        int size() const;
+        void submit(task_t task);
+        // run tasks until everything submitted so far is done
+        void wait();
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<task_t> tasks;
+        };
+
+        void workerThread(int id);
+        bool runOne(int id);
+
+    private:
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::atomic<bool> running{true};
+        std::atomic<int> pending{0}; // submitted and not finished
+        std::atomic<int> queued{0}; // submitted and not taken by anyone yet
+        std::atomic<unsigned int> nextWorker{0};
+        std::mutex sleepMutex;
+        std::condition_variable sleepCond; // workers: tasks to take or stop
+        std::condition_variable doneCond; // wait(): everything finished
+    };
+}
+
+#endif //TETRIS_TASKPOOL_H
@@ -1,6 +1,8 @@
 #include "tetris.h"
+#include "checkpoint.h"
+#include "eval.h"
+#include <algorithm>
 #include <thread>
-#include <experimental/random>
 
 using namespace tetris;
 
@@ -29,6 +31,11 @@ const size_t Tetris::RAND_QUEUE_LEN;
 const int Tetris::RAND_NUM_MIN;
 const int Tetris::RAND_NUM_MAX;
 const int Tetris::DOWN_STEP;
+const unsigned int Tetris::LOW_BANDWIDTH_BYTES;
+const unsigned long long Tetris::BOT_BUDGET_MS;
+
+Tetris::Tetris(const char *checkpointPath, const char *bookPath, const char *metricsPath, const char *datasetPath)
+        : CheckpointPath(checkpointPath), MetricsPath(metricsPath), DatasetPath(datasetPath), BookPath(bookPath) {}
 
 bool Tetris::initDisplay() {
     // init
@@ -51,12 +58,29 @@ void Tetris::enter() {
     using namespace std::chrono;
     using namespace std::this_thread;
 
-    pressAnyKey(InfoField.getWin(), "A, S, D: Left, Down, Right\n<Space>: Pause/Continue\n   Q   : exit\nPress any key to start\n");
-    display::d_wprintw(InfoField.getWin(), "[Game Start]\n");
+    pressAnyKey(InfoField.getWin(), "A, S, D: Left, Down, Right\n<Space>: Pause/Continue\n   L   : low bandwidth\n   P   : auto play\n   I   : output stats\n   V   : board features\n   Q   : exit\nPress any key to start\n");
+    if (BookPath && !Book.open(BookPath)) {
+        display::d_wprintw(InfoField.getWin(), "Can not open opening book %s\n", BookPath);
+    }
+    if (MetricsPath && !MetricsSrv.start(MetricsPath)) {
+        display::d_wprintw(InfoField.getWin(), "Can not serve metrics on %s\n", MetricsPath);
+    }
+    if (DatasetPath) {
+        int h, w, origin;
+        if (!GGameField.getCellRows(h, w, origin) || !Dataset.open(DatasetPath, h, w)) {
+            display::d_wprintw(InfoField.getWin(), "Can not write dataset %s\n", DatasetPath);
+        }
+    }
+    bool resumed = loadCheckpoint();
+    display::d_wprintw(InfoField.getWin(), resumed ? "[Game Resume]\n" : "[Game Start]\n");
 
     // start prepare
     display::nodelay(InfoField.getWin(), true);
-    CurScore = 0;
+    if (!resumed) {
+        CurScore = 0;
+        CurTick = 0;
+        Rng.reseed(duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+    }
     display::d_wmove(ScoreField.getWin(), 0, 0);
     display::d_wprintw(ScoreField.getWin(), "Score\n%9d\n", CurScore);
     display::d_wrefresh(ScoreField.getWin());
@@ -66,15 +90,17 @@ void Tetris::enter() {
     sleep_for(milliseconds(TICK_MS));
 
     // init tetris
-    CurTetrisList = TetrisList[getRand() % TetrisList.size()];
-    CurTetrisDir = getRand() % (int) CurTetrisList->size();
-    CurTetris = (*CurTetrisList)[CurTetrisDir];
-    GGameField.moveTetrisToStartPoint(CurTetris);
-
-    NxtTetrisList = TetrisList[getRand() % TetrisList.size()];
-    NxtTetrisDir = getRand() % (int) NxtTetrisList->size();
-    NxtTetris = (*NxtTetrisList)[NxtTetrisDir];
-    PreviewField.moveTetrisToCenter(NxtTetris);
+    if (!resumed) {
+        CurTetrisList = TetrisList[getRand() % TetrisList.size()];
+        CurTetrisDir = getRand() % (int) CurTetrisList->size();
+        CurTetris = (*CurTetrisList)[CurTetrisDir];
+        GGameField.moveTetrisToStartPoint(CurTetris);
+
+        NxtTetrisList = TetrisList[getRand() % TetrisList.size()];
+        NxtTetrisDir = getRand() % (int) NxtTetrisList->size();
+        NxtTetris = (*NxtTetrisList)[NxtTetrisDir];
+        PreviewField.moveTetrisToCenter(NxtTetris);
+    }
 
     std::thread timer(&Tetris::timerThread, this);
     rander.join();
@@ -82,6 +108,12 @@ void Tetris::enter() {
 
     // exit
     display::nodelay(InfoField.getWin(), false);
+    MetricsSrv.stop();
+    if (Dataset.isOpen()) {
+        bool ok = Dataset.close();
+        display::d_wprintw(InfoField.getWin(), ok ? "Samples %llu, dropped %llu\n" : "Write dataset failed\n",
+                           (unsigned long long) Dataset.written(), (unsigned long long) Dataset.dropped());
+    }
 
     display::d_wprintw(InfoField.getWin(), "Press q to exit\n");
     int ch;
@@ -105,8 +137,14 @@ bool Tetris::initField() {
 
     int sfHeight = 4;
     int sfWidth = 30;
-    int gfHeight = GlobalMaxRow;
-    int gfWidth = std::min((gfHeight * 4 / 3) / 2 * 2, GlobalMaxCol - sfWidth); // ensure weight is even
+    // a standard well, the board size the bots, the opening book and the engine kernels are made for.
+    // Terminals too small for it get the largest field that fits
+    int gfHeight = engine::DEFAULT_HEIGHT + 2;
+    int gfWidth = engine::DEFAULT_WIDTH * 2 + 2;
+    if (GlobalMaxRow < gfHeight || GlobalMaxCol < gfWidth + sfWidth) {
+        gfHeight = GlobalMaxRow;
+        gfWidth = std::min((gfHeight * 4 / 3) / 2 * 2, GlobalMaxCol - sfWidth); // ensure weight is even
+    }
     int pfWitdh = sfWidth;
     int pfHeight = std::min(pfWitdh / 2, 6);
     int ifWidth = sfWidth;
@@ -143,14 +181,11 @@ bool Tetris::initField() {
 void Tetris::randThread() {
     using namespace std::chrono;
     using namespace std::this_thread;
-    using namespace std::experimental;
-
-    reseed(duration_cast<seconds>(system_clock::now().time_since_epoch()).count());
 
     while (GameRunning) {
         QueueMutex.lock();
         while (RandQueue.size() < RAND_QUEUE_LEN) {
-            RandQueue.push(randint(RAND_NUM_MIN, RAND_NUM_MAX));
+            RandQueue.push(Rng.randint(RAND_NUM_MIN, RAND_NUM_MAX));
         }
         QueueMutex.unlock();
         sleep_for(milliseconds(TICK_MS * TICK_PER_FALL / 3));
@@ -161,7 +196,7 @@ void Tetris::timerThread() {
     using namespace std::chrono;
     using namespace std::this_thread;
 
-    unsigned long long tick = 0;
+    unsigned long long tick = CurTick;
     while (GameRunning) {
         std::thread run(&Tetris::runningThread, this, tick);
         run.detach();
@@ -173,6 +208,7 @@ void Tetris::timerThread() {
 
 void Tetris::runningThread(unsigned long long tick) {
     if (RunningMutex.try_lock()) {
+        auto start = std::chrono::steady_clock::now();
         int ch = -1;
         int tmp;
         while ((tmp = display::d_wgetchar(InfoField.getWin())) != display::GETCH_ERR) {
@@ -183,18 +219,53 @@ void Tetris::runningThread(unsigned long long tick) {
             case -1:
                 break;
             case ' ':
+                Paused = true;
                 display::nodelay(InfoField.getWin(), false);
                 pressAnyKey(InfoField.getWin(), "[Game Pause]\n");
                 display::d_wprintw(InfoField.getWin(), "[Game Continue]\n");
                 display::nodelay(InfoField.getWin(), true);
+                Paused = false;
+                start = std::chrono::steady_clock::now(); // time spent paused is not tick work
                 break;
             case 'q':
                 GameRunning = false;
+                saveCheckpoint(tick + 1);
                 display::d_wprintw(InfoField.getWin(), "[Game Exit]\n");
                 break;
             case 't':
                 display::d_wprintw(InfoField.getWin(), "Test info\n");
                 break;
+            case 'l':
+                display::setLowBandwidth(!display::isLowBandwidth(), LOW_BANDWIDTH_BYTES);
+                display::d_wprintw(InfoField.getWin(), "[Low bandwidth %s]\n", display::isLowBandwidth() ? "on" : "off");
+                break;
+            case 'p':
+                AutoPlay = !AutoPlay;
+                AutoPlayed = false;
+                if (AutoPlay && !AutoPlayer) AutoPlayer.reset(new engine::Bot());
+                display::d_wprintw(InfoField.getWin(), "[Auto play %s]\n", AutoPlay ? "on" : "off");
+                break;
+            case 'v': {
+                engine::Board board{};
+                int origin;
+                if (!fieldToBoard(board, origin)) {
+                    display::d_wprintw(InfoField.getWin(), "Field is too large for board features\n");
+                    break;
+                }
+                engine::Features f{};
+                engine::features(board, f);
+                display::d_wprintw(InfoField.getWin(), "Height %d/%d Holes %d Bump %d\nTrans %d/%d Wells %d\n",
+                                   f.aggregateHeight, f.maxHeight, f.holes, f.bumpiness,
+                                   f.rowTransitions, f.colTransitions, f.wells);
+                break;
+            }
+            case 'i': {
+                display::OutputStats st = display::getOutputStats();
+                display::d_wprintw(InfoField.getWin(), "Out %llu B/frame, max %llu\nAvg %llu B/frame, held %llu\n",
+                                   st.lastFrameBytes, st.maxFrameBytes,
+                                   st.frames ? st.totalBytes / st.frames : 0ULL, st.deferredFrames);
+                break;
+            }
             case 'w':
             case 'a':
             case 's':
@@ -208,6 +279,8 @@ void Tetris::runningThread(unsigned long long tick) {
                 display::d_wprintw(InfoField.getWin(), "Unsupported key 0x%2X [%c]\n", ch, ch);
         }
 
+        if (AutoPlay) autoPlay();
+
         // time to fall
         if (!(tick % TICK_PER_FALL)) {
             auto checkRet = GGameField.hitCheck(1, 0, CurTetris);
@@ -217,10 +290,17 @@ void Tetris::runningThread(unsigned long long tick) {
                 checkRet = GGameField.hitCheck(0, 0, CurTetris, true);
                 if (checkRet != display::GameField::CHECK_OK) { // Game Over
                     GameRunning = false;
+                    GameMetrics.gameOver();
+                    if (CheckpointPath) Checkpoint::remove(CheckpointPath);
                     display::d_wprintw(InfoField.getWin(), "[Game Over]\n");
                     return;
                 }
 
+                // the board it lands on, for the dataset
+                engine::Board before{};
+                int origin = 0;
+                bool sample = Dataset.isOpen() && fieldToBoard(before, origin);
+
                 // fall to bottom, no need to erase CurTetris
                 GGameField.add(CurTetris);
 
@@ -228,7 +308,9 @@ void Tetris::runningThread(unsigned long long tick) {
                 int lineList[display::Tetrimino::HEIGHT];
                 int completeNum = GGameField.checkComplete(CurTetris, lineList);
                 if (completeNum) {
-                    for (int k = 0; k < FLASH_TIMES; ++k) {
+                    // flashing is cosmetic, not worth the bytes on a slow link, and its sleeps are not tick work
+                    auto flash = std::chrono::steady_clock::now();
+                    for (int k = 0; k < FLASH_TIMES && !display::isLowBandwidth(); ++k) {
                         for (int i = 0; i < completeNum; ++i) {
                             GGameField.hideLine(lineList[i]);
                         }
@@ -238,10 +320,18 @@ void Tetris::runningThread(unsigned long long tick) {
                         }
                         std::this_thread::sleep_for(std::chrono::milliseconds(FLASH_MS / 2));
                     }
+                    start += std::chrono::steady_clock::now() - flash;
                     GGameField.fall(lineList, completeNum);
                 }
 
                 CurScore += completeNum * completeNum * SCORE_BASE;
+                GameMetrics.piecePlaced(completeNum, completeNum * completeNum * SCORE_BASE);
+                if (sample) {
+                    engine::Piece landed{(int8_t) kindOf(CurTetrisList), (int8_t) CurTetrisDir,
+                                         (int8_t) CurTetris.getY(), (int8_t) ((CurTetris.getX() - origin) / 2)};
+                    Dataset.append(before, landed, kindOf(NxtTetrisList), completeNum,
+                                   completeNum * completeNum * SCORE_BASE);
+                }
                 display::d_wmove(ScoreField.getWin(), 0, 0);
                 display::d_wprintw(ScoreField.getWin(), "Score\n%9d\n", CurScore);
                 display::d_wrefresh(ScoreField.getWin());
@@ -252,17 +342,25 @@ void Tetris::runningThread(unsigned long long tick) {
                 CurTetrisDir = NxtTetrisDir;
                 CurTetris = NxtTetris;
                 GGameField.moveTetrisToStartPoint(CurTetris);
+                AutoPlayed = false;
+                ++PieceCount;
 
                 NxtTetrisList = TetrisList[getRand() % TetrisList.size()];
                 NxtTetrisDir = getRand() % (int) NxtTetrisList->size();
                 NxtTetris = (*NxtTetrisList)[NxtTetrisDir];
                 PreviewField.moveTetrisToCenter(NxtTetris);
+
+                saveCheckpoint(tick + 1);
             }
         }
 
+        display::endFrame();
+        GameMetrics.tickRun(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
         RunningMutex.unlock();
     } else {
 //        display::d_wprintw(InfoField.getWin(), "Skip tick %llu\n", tick);
+        if (!Paused) GameMetrics.tickSkipped();
     }
 }
 
@@ -326,3 +424,179 @@ void Tetris::rotateTetris(display::Tetrimino &t) {
         CurTetris.show(GGameField.getWin());
     }
 }
+
+bool Tetris::loadCheckpoint() {
+    if (!CheckpointPath) return false;
+
+    Checkpoint cp;
+    if (!cp.open(CheckpointPath)) return false;
+    const CheckpointHeader *h = cp.header();
+
+    int height, width;
+    GGameField.getInnerHW(height, width);
+    if (h->height != height || h->width != width) {
+        display::d_wprintw(InfoField.getWin(), "Checkpoint is for a %dx%d field, start a new game\n", h->height, h->width);
+        return false;
+    }
+    if (h->curKind < 0 || h->curKind >= (int) TetrisList.size() ||
+        h->nxtKind < 0 || h->nxtKind >= (int) TetrisList.size() ||
+        h->curDir < 0 || h->curDir >= (int) TetrisList[h->curKind]->size() ||
+        h->nxtDir < 0 || h->nxtDir >= (int) TetrisList[h->nxtKind]->size() ||
+        !std::all_of(h->randQueue, h->randQueue + h->randQueueLen,
+                     [](int32_t r) { return r >= RAND_NUM_MIN && r <= RAND_NUM_MAX; })) {
+        display::d_wprintw(InfoField.getWin(), "Checkpoint is broken, start a new game\n");
+        return false;
+    }
+
+    // the falling piece must sit on the grid pieces move on and must not overlap the field
+    int sy, sx;
+    GGameField.getStartPoint(sy, sx);
+    display::Tetrimino cur = (*TetrisList[h->curKind])[h->curDir];
+    cur.moveWithOutPrint(h->curY, h->curX);
+    GGameField.importMap(cp.cells(), false);
+    if ((h->curX - sx) % 2 || GGameField.hitCheck(0, 0, cur) != display::GameField::CHECK_OK) {
+        std::vector<signed char> blank((size_t) height * width, (signed char) display::INVALID_COLOR);
+        GGameField.importMap(blank.data(), false);
+        display::d_wprintw(InfoField.getWin(), "Checkpoint is broken, start a new game\n");
+        return false;
+    }
+    GGameField.refreshWin();
+    CurScore = h->score;
+    CurTick = h->tick;
+
+    QueueMutex.lock();
+    Rng.setState(h->rngState);
+    RandQueue = std::queue<int>();
+    for (uint32_t i = 0; i < h->randQueueLen; ++i) {
+        RandQueue.push(h->randQueue[i]);
+    }
+    QueueMutex.unlock();
+
+    CurTetrisList = TetrisList[h->curKind];
+    CurTetrisDir = h->curDir;
+    CurTetris = (*CurTetrisList)[CurTetrisDir];
+    CurTetris.moveTo(GGameField.getWin(), h->curY, h->curX);
+
+    NxtTetrisList = TetrisList[h->nxtKind];
+    NxtTetrisDir = h->nxtDir;
+    NxtTetris = (*NxtTetrisList)[NxtTetrisDir];
+    PreviewField.moveTetrisToCenter(NxtTetris);
+    return true;
+}
+
+void Tetris::saveCheckpoint(unsigned long long nextTick) {
+    static_assert(RAND_QUEUE_LEN <= CheckpointHeader::MAX_RAND_QUEUE, "checkpoint can not hold the random queue");
+    if (!CheckpointPath) return;
+
+    CheckpointHeader h{};
+    Checkpoint::initHeader(h);
+    GGameField.getInnerHW(h.height, h.width);
+    std::vector<signed char> cells((size_t) h.height * h.width);
+    GGameField.exportMap(cells.data());
+
+    h.tick = nextTick;
+    h.score = CurScore;
+    h.curKind = kindOf(CurTetrisList);
+    h.curDir = CurTetrisDir;
+    CurTetris.getPos(h.curY, h.curX);
+    h.nxtKind = kindOf(NxtTetrisList);
+    h.nxtDir = NxtTetrisDir;
+
+    QueueMutex.lock();
+    h.rngState = Rng.getState();
+    std::queue<int> q = RandQueue;
+    QueueMutex.unlock();
+    while (!q.empty() && h.randQueueLen < CheckpointHeader::MAX_RAND_QUEUE) {
+        h.randQueue[h.randQueueLen++] = q.front();
+        q.pop();
+    }
+
+    if (!Checkpoint::write(CheckpointPath, h, cells.data())) {
+        display::d_wprintw(InfoField.getWin(), "Save checkpoint failed\n");
+    }
+}
+
+int Tetris::kindOf(const std::vector<display::Tetrimino> *list) {
+    for (size_t i = 0; i < TetrisList.size(); ++i) {
+        if (TetrisList[i] == list) return (int) i;
+    }
+    return -1;
+}
+
+// The search runs on its own thread beside the ticks, a later tick picks up the result and plays it.
+// The tick itself only starts the search or checks whether it is done, so it never waits for it.
+void Tetris::autoPlay() {
+    if (AutoPlayed) return;
+    if (Planning.valid()) {
+        if (Planning.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        PlanResult plan = Planning.get();
+        if (plan.piece != PieceCount) return; // for a piece that has landed meanwhile, search again
+        AutoPlayed = true;
+        if (plan.found) followPlan(plan.target);
+        return;
+    }
+
+    engine::Board board{};
+    int origin;
+    if (!fieldToBoard(board, origin)) {
+        AutoPlay = false;
+        display::d_wprintw(InfoField.getWin(), "Field is too large for auto play\n");
+        return;
+    }
+    if (Book.isOpen() && (Book.height() != board.height || Book.width() != board.width)) {
+        display::d_wprintw(InfoField.getWin(), "Opening book is for %dx%d, field is %dx%d\n",
+                           Book.width(), Book.height(), board.width, board.height);
+        Book.close();
+    }
+    int sy, sx;
+    GGameField.getStartPoint(sy, sx);
+    engine::Piece cur{(int8_t) kindOf(CurTetrisList), (int8_t) CurTetrisDir,
+                      (int8_t) CurTetris.getY(), (int8_t) ((CurTetris.getX() - origin) / 2)};
+    engine::Piece nxt{(int8_t) kindOf(NxtTetrisList), (int8_t) NxtTetrisDir, (int8_t) sy, (int8_t) ((sx - origin) / 2)};
+
+    engine::Placement target{};
+    if (Book.lookup(board, cur, nxt.kind, target)) {
+        AutoPlayed = true;
+        followPlan(target);
+        return;
+    }
+    Planning = std::async(std::launch::async, [this, board, cur, nxt, piece = PieceCount] {
+        PlanResult plan{piece, false, {}};
+        auto deadline = engine::Bot::clock::now() + std::chrono::milliseconds(BOT_BUDGET_MS);
+        plan.found = AutoPlayer->plan(board, cur, nxt, deadline, plan.target);
+        return plan;
+    });
+}
+
+// play it out with the same moves as the keys, give up if the field disagrees with the plan
+void Tetris::followPlan(const engine::Placement &target) {
+    int h, w, origin;
+    if (!GGameField.getCellRows(h, w, origin)) return;
+    while (CurTetrisDir != target.rot) {
+        int dir = CurTetrisDir;
+        rotateTetris(CurTetris);
+        if (CurTetrisDir == dir) return;
+    }
+    int x = (CurTetris.getX() - origin) / 2;
+    while (x != target.x) {
+        moveTetris(CurTetris, x < target.x ? 'd' : 'a');
+        int newX = (CurTetris.getX() - origin) / 2;
+        if (newX == x) return;
+        x = newX;
+    }
+    // drop right away, it lands on the next fall
+    for (int y = CurTetris.getY() - 1; y != CurTetris.getY();) {
+        y = CurTetris.getY();
+        moveTetris(CurTetris, 's');
+    }
+}
+
+bool Tetris::fieldToBoard(engine::Board &board, int &origin) const {
+    int h, w;
+    const uint64_t *rows = GGameField.getCellRows(h, w, origin);
+    if (!rows || h > engine::MAX_HEIGHT || w > engine::MAX_WIDTH || w < engine::PIECE_SIZE) return false;
+
+    board.reset(h, w);
+    std::copy(rows, rows + h, board.rows);
+    return true;
+}
@@ -1,8 +1,15 @@
 #ifndef TETRIS_TETRIS_H
 #define TETRIS_TETRIS_H
 
+#include "book.h"
+#include "bot.h"
+#include "dataset.h"
 #include "display.h"
+#include "metrics.h"
+#include "random.h"
 #include <atomic>
+#include <future>
+#include <memory>
 
 #include <mutex>
 #include <vector>
@@ -15,6 +22,8 @@ namespace tetris {
     class Tetris {
     public:
         Tetris() = default;
+        explicit Tetris(const char *checkpointPath, const char *bookPath = nullptr, const char *metricsPath = nullptr,
+                        const char *datasetPath = nullptr);
         bool initDisplay();
         void enter();
         void destroyDisplay();
@@ -27,6 +36,12 @@ namespace tetris {
         int getRand();
         void moveTetris(display::Tetrimino &t, char dir);
         void rotateTetris(display::Tetrimino &t);
+        bool loadCheckpoint();
+        void saveCheckpoint(unsigned long long nextTick);
+        static int kindOf(const std::vector<display::Tetrimino> *list);
+        void autoPlay();
+        void followPlan(const engine::Placement &target);
+        bool fieldToBoard(engine::Board &board, int &origin) const;
 
     private:
         const static unsigned long long TICK_MS = 20;
@@ -38,6 +53,8 @@ namespace tetris {
         const static int RAND_NUM_MIN = 0;
         const static int RAND_NUM_MAX = 27;
         const static int DOWN_STEP = 5;
+        const static unsigned int LOW_BANDWIDTH_BYTES = 256; // per frame, about 100 kbit/s
+        const static unsigned long long BOT_BUDGET_MS = 15; // search time per piece, beside the ticks
 
         const static std::vector<const std::vector<display::Tetrimino> *> TetrisList;
 
@@ -49,9 +66,19 @@ namespace tetris {
         display::Field InfoField;
 
         std::atomic<bool> GameRunning = false;
+        std::atomic<bool> Paused = false; // ticks missed meanwhile are not skipped, nothing is meant to run
         std::mutex RunningMutex;
         std::mutex QueueMutex;
         std::queue<int> RandQueue;
+        Random Rng; // guarded by QueueMutex
+
+        const char *CheckpointPath = nullptr;
+        const char *MetricsPath = nullptr;
+        Metrics GameMetrics; // written without RunningMutex, the server only reads atomics
+        MetricsServer MetricsSrv{GameMetrics};
+        const char *DatasetPath = nullptr;
+        DatasetWriter Dataset; // one sample per landed piece
+        unsigned long long CurTick = 0;
 
         unsigned int CurScore = 0;
         const std::vector<display::Tetrimino> *CurTetrisList = nullptr;
@@ -60,6 +87,20 @@ namespace tetris {
         const std::vector<display::Tetrimino> *NxtTetrisList = nullptr;
         int NxtTetrisDir = -1;
         display::Tetrimino NxtTetris;
+
+        // guarded by RunningMutex
+        bool AutoPlay = false;
+        bool AutoPlayed = false; // CurTetris is already placed by the bot
+        std::unique_ptr<engine::Bot> AutoPlayer;
+        struct PlanResult {
+            unsigned long long piece; // PieceCount when the search started
+            bool found;
+            engine::Placement target;
+        };
+        std::future<PlanResult> Planning; // search running beside the ticks
+        unsigned long long PieceCount = 0; // pieces landed so far
+        const char *BookPath = nullptr;
+        engine::OpeningBook Book;
     };
 }
 
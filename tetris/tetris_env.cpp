@@ -0,0 +1,162 @@
+#include "tetris_env.h"
+#include "engine.h"
+#include "batch.h"
+#include "rollback.h"
+#include <cstddef>
+#include <new>
+
+// ================================================== layout checks
+static_assert(sizeof(tetris_obs) == sizeof(engine::State), "tetris_obs must mirror engine::State");
+static_assert(offsetof(tetris_obs, height) == offsetof(engine::State, board) + offsetof(engine::Board, height), "height");
+static_assert(offsetof(tetris_obs, width) == offsetof(engine::State, board) + offsetof(engine::Board, width), "width");
+static_assert(offsetof(tetris_obs, rows) == offsetof(engine::State, board) + offsetof(engine::Board, rows), "rows");
+static_assert(offsetof(tetris_obs, cur) == offsetof(engine::State, cur), "cur");
+static_assert(offsetof(tetris_obs, nxt) == offsetof(engine::State, nxt), "nxt");
+static_assert(offsetof(tetris_obs, score) == offsetof(engine::State, score), "score");
+static_assert(offsetof(tetris_obs, lines) == offsetof(engine::State, lines), "lines");
+static_assert(offsetof(tetris_obs, tick) == offsetof(engine::State, tick), "tick");
+static_assert(offsetof(tetris_obs, rng_state) == offsetof(engine::State, rng), "rng_state");
+static_assert(offsetof(tetris_obs, done) == offsetof(engine::State, done), "done");
+static_assert(TETRIS_ENV_MAX_HEIGHT == engine::MAX_HEIGHT && TETRIS_ENV_MAX_WIDTH == engine::MAX_WIDTH, "size");
+static_assert(TETRIS_ENV_KIND_NUM == engine::KIND_NUM && TETRIS_ENV_TICK_PER_FALL == engine::TICK_PER_FALL, "rule");
+static_assert((int) TETRIS_ACT_NUM == (int) engine::ACT_NUM, "action");
+static_assert(TETRIS_ENV_MAX_VEC_WIDTH == engine::Batch::MAX_BATCH_WIDTH, "batch width");
+static_assert(TETRIS_ENV_MAX_ROLLBACK_WIDTH == engine::Snapshot::MAX_SNAPSHOT_WIDTH, "rollback width");
+
+struct tetris_env {
+    engine::Game game;
+    int height;
+    int width;
+};
+
+struct tetris_rollback {
+    explicit tetris_rollback(int capacity) : rollback(capacity) {}
+
+    engine::Rollback rollback;
+    int height;
+    int width;
+};
+
+struct tetris_vec {
+    engine::Batch batch;
+    tetris_vec_view view;
+};
+
+// ================================================== functions
+tetris_env *tetris_env_create(uint64_t seed, int height, int width) {
+    if (!height) height = engine::DEFAULT_HEIGHT;
+    if (!width) width = engine::DEFAULT_WIDTH;
+
+    auto *env = new(std::nothrow) tetris_env;
+    if (!env) return nullptr;
+    env->height = height;
+    env->width = width;
+    if (!env->game.reset(seed, height, width)) {
+        delete env;
+        return nullptr;
+    }
+    return env;
+}
+
+void tetris_env_destroy(tetris_env *env) {
+    delete env;
+}
+
+void tetris_env_reset(tetris_env *env, uint64_t seed) {
+    env->game.reset(seed, env->height, env->width);
+}
+
+int tetris_env_step(tetris_env *env, int action, int *done) {
+    int reward = (int) env->game.step(action);
+    if (done) *done = env->game.state().done;
+    return reward;
+}
+
+const tetris_obs *tetris_env_observe(const tetris_env *env) {
+    return reinterpret_cast<const tetris_obs *>(&env->game.state());
+}
+
+int tetris_env_rotation_num(int kind) {
+    if (kind < 0 || kind >= engine::KIND_NUM) return 0;
+    return engine::rotationNum(kind);
+}
+
+uint16_t tetris_env_shape(int kind, int rot) {
+    if (kind < 0 || kind >= engine::KIND_NUM || rot < 0 || rot >= engine::rotationNum(kind)) return 0;
+    return engine::shapeOf(kind, rot);
+}
+
+tetris_vec *tetris_vec_create(int size, uint64_t seed, int height, int width) {
+    if (!height) height = engine::DEFAULT_HEIGHT;
+    if (!width) width = engine::DEFAULT_WIDTH;
+
+    auto *vec = new(std::nothrow) tetris_vec;
+    if (!vec) return nullptr;
+    engine::Batch &b = vec->batch;
+    if (!b.init(size, height, width)) {
+        delete vec;
+        return nullptr;
+    }
+    b.resetAll(seed);
+    vec->view = tetris_vec_view{b.size(), b.height(), b.width(), b.rows(),
+                                b.curKind(), b.curRot(), b.curY(), b.curX(), b.nxtKind(), b.nxtRot(),
+                                b.score(), b.lines(), b.done()};
+    return vec;
+}
+
+void tetris_vec_destroy(tetris_vec *vec) {
+    delete vec;
+}
+
+void tetris_vec_reset(tetris_vec *vec, int index, uint64_t seed) {
+    if (index >= 0 && index < vec->batch.size()) vec->batch.reset(index, seed);
+}
+
+void tetris_vec_step(tetris_vec *vec, const uint8_t *actions, int32_t *rewards, uint8_t *dones) {
+    vec->batch.step(actions, rewards, dones);
+}
+
+const tetris_vec_view *tetris_vec_observe(const tetris_vec *vec) {
+    return &vec->view;
+}
+
+tetris_rollback *tetris_rollback_create(int capacity, uint64_t seed, int height, int width) {
+    if (!height) height = engine::DEFAULT_HEIGHT;
+    if (!width) width = engine::DEFAULT_WIDTH;
+
+    auto *rb = new(std::nothrow) tetris_rollback(capacity);
+    if (!rb) return nullptr;
+    rb->height = height;
+    rb->width = width;
+    if (!rb->rollback.reset(seed, height, width)) {
+        delete rb;
+        return nullptr;
+    }
+    return rb;
+}
+
+void tetris_rollback_destroy(tetris_rollback *rb) {
+    delete rb;
+}
+
+void tetris_rollback_reset(tetris_rollback *rb, uint64_t seed) {
+    rb->rollback.reset(seed, rb->height, rb->width);
+}
+
+int tetris_rollback_step(tetris_rollback *rb, int action, int *done) {
+    int reward = (int) rb->rollback.step(action);
+    if (done) *done = rb->rollback.state().done;
+    return reward;
+}
+
+int tetris_rollback_correct(tetris_rollback *rb, uint64_t tick, int action) {
+    return rb->rollback.correct(tick, action);
+}
+
+uint64_t tetris_rollback_oldest(const tetris_rollback *rb) {
+    return rb->rollback.oldest();
+}
+
+const tetris_obs *tetris_rollback_observe(const tetris_rollback *rb) {
+    return reinterpret_cast<const tetris_obs *>(&rb->rollback.state());
+}
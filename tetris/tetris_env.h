@@ -0,0 +1,129 @@
+#ifndef TETRIS_TETRIS_ENV_H
+#define TETRIS_TETRIS_ENV_H
+
+/* Plain C interface of libtetris_env, a headless game for reinforcement-learning environments.
+ * One step is one game tick: the key is applied, then the piece falls every TETRIS_ENV_TICK_PER_FALL ticks. */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(TETRIS_ENV_BUILD)
+#define TETRIS_ENV_API __declspec(dllexport)
+#else
+#define TETRIS_ENV_API __declspec(dllimport)
+#endif
+#else
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TETRIS_ENV_MAX_HEIGHT 64
+#define TETRIS_ENV_MAX_WIDTH 64
+#define TETRIS_ENV_KIND_NUM 7
+#define TETRIS_ENV_TICK_PER_FALL 8
+
+enum tetris_action {
+    TETRIS_ACT_NONE = 0,
+    TETRIS_ACT_LEFT,
+    TETRIS_ACT_RIGHT,
+    TETRIS_ACT_DOWN,
+    TETRIS_ACT_ROTATE,
+    TETRIS_ACT_NUM
+};
+
+typedef struct tetris_piece {
+    int8_t kind; /* I L J O S T Z */
+    int8_t rot;
+    int8_t y; /* top left of the 4x4 shape, may be above the board */
+    int8_t x;
+} tetris_piece;
+
+/* Observation buffer, read in place. Only the first height rows are meaningful. */
+typedef struct tetris_obs {
+    int32_t height;
+    int32_t width;
+    uint64_t rows[TETRIS_ENV_MAX_HEIGHT]; /* bit c of rows[y] is set if cell (y, c) is filled */
+    tetris_piece cur;
+    tetris_piece nxt;
+    uint32_t score;
+    uint32_t lines;
+    uint64_t tick;
+    uint64_t rng_state;
+    uint8_t done;
+} tetris_obs;
+
+typedef struct tetris_env tetris_env;
+
+/* height and width in cells, 0 picks the standard 20x10. Return NULL on invalid size. */
+TETRIS_ENV_API tetris_env *tetris_env_create(uint64_t seed, int height, int width);
+TETRIS_ENV_API void tetris_env_destroy(tetris_env *env);
+TETRIS_ENV_API void tetris_env_reset(tetris_env *env, uint64_t seed);
+/* return the reward (score gained), *done is set when the game is over and may be NULL */
+TETRIS_ENV_API int tetris_env_step(tetris_env *env, int action, int *done);
+/* pointer stays valid and is updated in place until the env is destroyed */
+TETRIS_ENV_API const tetris_obs *tetris_env_observe(const tetris_env *env);
+
+/* 4x4 shape of a piece, bit (i * 4 + j) is row i column j */
+TETRIS_ENV_API int tetris_env_rotation_num(int kind);
+TETRIS_ENV_API uint16_t tetris_env_shape(int kind, int rot);
+
+/* ---------------------------------------- batched games
+ * Many games of one size stepped together. Width is at most TETRIS_ENV_MAX_VEC_WIDTH.
+ * Arrays are indexed by game, row y of game g is rows[y * size + g]. */
+
+#define TETRIS_ENV_MAX_VEC_WIDTH 16
+
+typedef struct tetris_vec_view {
+    int32_t size;
+    int32_t height;
+    int32_t width;
+    const uint16_t *rows;
+    const int8_t *cur_kind;
+    const int8_t *cur_rot;
+    const int8_t *cur_y;
+    const int8_t *cur_x;
+    const int8_t *nxt_kind;
+    const int8_t *nxt_rot;
+    const uint32_t *score;
+    const uint32_t *lines;
+    const uint8_t *done;
+} tetris_vec_view;
+
+typedef struct tetris_vec tetris_vec;
+
+/* game g is seeded with seed + g */
+TETRIS_ENV_API tetris_vec *tetris_vec_create(int size, uint64_t seed, int height, int width);
+TETRIS_ENV_API void tetris_vec_destroy(tetris_vec *vec);
+TETRIS_ENV_API void tetris_vec_reset(tetris_vec *vec, int index, uint64_t seed);
+/* actions has size entries, rewards and dones may be NULL. A finished game stays done until reset. */
+TETRIS_ENV_API void tetris_vec_step(tetris_vec *vec, const uint8_t *actions, int32_t *rewards, uint8_t *dones);
+/* pointers stay valid until the batch is destroyed */
+TETRIS_ENV_API const tetris_vec_view *tetris_vec_observe(const tetris_vec *vec);
+
+/* ---------------------------------------- rollback games
+ * A game that keeps the last capacity ticks, for versus play where remote inputs arrive late.
+ * Width is at most TETRIS_ENV_MAX_ROLLBACK_WIDTH. */
+
+#define TETRIS_ENV_MAX_ROLLBACK_WIDTH 16
+
+typedef struct tetris_rollback tetris_rollback;
+
+/* capacity 0 picks the default of 64 ticks */
+TETRIS_ENV_API tetris_rollback *tetris_rollback_create(int capacity, uint64_t seed, int height, int width);
+TETRIS_ENV_API void tetris_rollback_destroy(tetris_rollback *rb);
+TETRIS_ENV_API void tetris_rollback_reset(tetris_rollback *rb, uint64_t seed);
+TETRIS_ENV_API int tetris_rollback_step(tetris_rollback *rb, int action, int *done);
+/* replace the input of a past tick and replay up to the current one, return 0 if the tick is no longer kept */
+TETRIS_ENV_API int tetris_rollback_correct(tetris_rollback *rb, uint64_t tick, int action);
+/* oldest tick that can still be corrected */
+TETRIS_ENV_API uint64_t tetris_rollback_oldest(const tetris_rollback *rb);
+TETRIS_ENV_API const tetris_obs *tetris_rollback_observe(const tetris_rollback *rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TETRIS_TETRIS_ENV_H */